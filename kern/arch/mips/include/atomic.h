@@ -0,0 +1,56 @@
+#ifndef _MIPS_ATOMIC_H_
+#define _MIPS_ATOMIC_H_
+
+/*
+ * Atomic operations built from LL/SC; see the comment on
+ * spinlock_data_testandset in <machine/spinlock.h> for how those
+ * work. Each update is retried until the SC succeeds. Everything
+ * between the LL and the SC is done in registers, as it must be.
+ *
+ * See include/atomic.h for further information.
+ */
+
+ATOMIC_INLINE
+unsigned
+atomic_add(volatile unsigned *p, int delta)
+{
+	unsigned old, new;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set noreorder;"	/* we fill the delay slots */
+		"1: ll %0, 0(%2);"	/*   old = *p */
+		"addu %1, %0, %3;"	/*   new = old + delta */
+		"sc %1, 0(%2);"		/*   *p = new; new = success? */
+		"beqz %1, 1b;"		/*   lost the word; go again */
+		"nop;"			/*   (delay slot) */
+		".set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (new) : "r" (p), "r" (delta)
+		: "memory");
+	return old + delta;
+}
+
+ATOMIC_INLINE
+unsigned
+atomic_inc_not_zero(volatile unsigned *p)
+{
+	unsigned old, new;
+
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 instructions */
+		".set noreorder;"	/* we fill the delay slots */
+		"1: ll %0, 0(%2);"	/*   old = *p */
+		"beqz %0, 2f;"		/*   zero: leave it alone */
+		"addiu %1, %0, 1;"	/*   (delay slot) new = old + 1 */
+		"sc %1, 0(%2);"		/*   *p = new; new = success? */
+		"beqz %1, 1b;"		/*   lost the word; go again */
+		"nop;"			/*   (delay slot) */
+		"2: .set pop"		/* restore assembler mode */
+		: "=&r" (old), "=&r" (new) : "r" (p)
+		: "memory");
+	return old;
+}
+
+#endif /* _MIPS_ATOMIC_H_ */
@@ -117,11 +117,13 @@ paddr_t ram_getfirstfree(void);
  * We'll take up to 16 invalidations before just flushing the whole TLB.
  */
 
+struct addrspace;
+struct semaphore;
+
 struct tlbshootdown {
-	/*
-	 * Change this to what you need for your VM design.
-	 */
-	int ts_placeholder;
+	struct addrspace *ts_as;	/* whose entry to drop */
+	vaddr_t ts_vaddr;		/* for which page */
+	struct semaphore *ts_done;	/* V'd once it is gone */
 };
 
 #define TLBSHOOTDOWN_MAX 16
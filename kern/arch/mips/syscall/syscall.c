@@ -38,6 +38,9 @@
 #include <file.h>
 #include <copyinout.h>
 #include <endian.h>
+#include <clock.h>
+#include <sysstats.h>
+#include "opt-dumbvm.h"
 
 
 /*
@@ -88,12 +91,18 @@ syscall(struct trapframe *tf)
 	uint64_t offset; /* unsigned 64bit val used for lseek offset */
 	int whence; /* whence value copys from user statck */
 	off_t retval64; 
+	uint32_t cfr_args[2]; /* stack args of copy_file_range/select */
+#if !OPT_DUMBVM
+	uint32_t mmap_args[4]; /* fd, padding and offset of mmap */
+#endif
+	struct timespec start; /* for the per-syscall latency stats */
 
 	KASSERT(curthread != NULL);
 	KASSERT(curthread->t_curspl == 0);
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+	gettime(&start);
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -139,12 +148,143 @@ syscall(struct trapframe *tf)
 		err = sys_write((int) tf->tf_a0, (void *) tf->tf_a1,
 				(size_t) tf->tf_a2, &retval);
 		break;
+
+		case SYS_readv:
+		err = sys_readv((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+				(int)tf->tf_a2, &retval);
+		break;
+
+		case SYS_writev:
+		err = sys_writev((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+				(int)tf->tf_a2, &retval);
+		break;
+
+		case SYS_pread:
+		case SYS_pwrite:
+		case SYS_preadv:
+		case SYS_pwritev:
+		/* 64-bit offset is aligned, so it lives on the user stack */
+		err = copyin((userptr_t)tf->tf_sp + 16, &offset, sizeof(offset));
+		if (err){
+			break;
+		}
+		if (callno == SYS_pread)
+			err = sys_pread((int)tf->tf_a0, (void *)tf->tf_a1,
+					(size_t)tf->tf_a2, (off_t)offset, &retval);
+		else if (callno == SYS_pwrite)
+			err = sys_pwrite((int)tf->tf_a0, (void *)tf->tf_a1,
+					(size_t)tf->tf_a2, (off_t)offset, &retval);
+		else if (callno == SYS_preadv)
+			err = sys_preadv((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+					(int)tf->tf_a2, (off_t)offset, &retval);
+		else
+			err = sys_pwritev((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+					(int)tf->tf_a2, (off_t)offset, &retval);
+		break;
+
 		case SYS_dup2:
 		err = sys_dup2(
 				tf->tf_a0,tf->tf_a1, & retval 
 			);
 		break;
 
+		case SYS_pipe:
+		err = sys_pipe((userptr_t)tf->tf_a0, &retval);
+		break;
+
+		case SYS_fork:
+		err = sys_fork(tf, &retval);
+		break;
+
+		case SYS__exit:
+		sys__exit((int)tf->tf_a0);
+		break;
+
+		case SYS_waitpid:
+		err = sys_waitpid((pid_t)tf->tf_a0, (userptr_t)tf->tf_a1,
+				  (int)tf->tf_a2, &retval);
+		break;
+
+		case SYS_getrusage:
+		err = sys_getrusage((int)tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+		case SYS_getrlimit:
+		err = sys_getrlimit((int)tf->tf_a0, (userptr_t)tf->tf_a1);
+		break;
+
+		case SYS_setrlimit:
+		err = sys_setrlimit((int)tf->tf_a0,
+				(const_userptr_t)tf->tf_a1);
+		break;
+
+#if !OPT_DUMBVM
+		case SYS_sbrk:
+		err = sys_sbrk((intptr_t)tf->tf_a0, &retval);
+		break;
+
+		case SYS_mmap:
+		/* fd, then the aligned 64-bit offset, are on the stack */
+		err = copyin((userptr_t)tf->tf_sp + 16, mmap_args,
+			     sizeof(mmap_args));
+		if (err){
+			break;
+		}
+		join32to64(mmap_args[2], mmap_args[3], &offset);
+		err = sys_mmap((vaddr_t)tf->tf_a0, (size_t)tf->tf_a1,
+				(int)tf->tf_a2, (int)tf->tf_a3,
+				(int)mmap_args[0], (off_t)offset, &retval);
+		break;
+
+		case SYS_munmap:
+		err = sys_munmap((vaddr_t)tf->tf_a0, (size_t)tf->tf_a1);
+		break;
+
+		case SYS_msync:
+		err = sys_msync((vaddr_t)tf->tf_a0, (size_t)tf->tf_a1,
+				(int)tf->tf_a2);
+		break;
+#endif
+
+
+		case SYS_ioring_setup:
+		err = sys_ioring_setup((userptr_t)tf->tf_a0,
+				(unsigned)tf->tf_a1);
+		break;
+
+		case SYS_ioring_enter:
+		err = sys_ioring_enter((unsigned)tf->tf_a0, &retval);
+		break;
+
+		case SYS_copy_file_range:
+		/* len and flags are the fifth and sixth args, on the stack */
+		err = copyin((userptr_t)tf->tf_sp + 16, cfr_args,
+			     sizeof(cfr_args));
+		if (err){
+			break;
+		}
+		err = sys_copy_file_range((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+				(int)tf->tf_a2, (userptr_t)tf->tf_a3,
+				(size_t)cfr_args[0], (unsigned)cfr_args[1],
+				&retval);
+		break;
+
+		case SYS_poll:
+		err = sys_poll((userptr_t)tf->tf_a0, (unsigned)tf->tf_a1,
+				(int)tf->tf_a2, &retval);
+		break;
+
+		case SYS_select:
+		/* the timeout is the fifth arg, on the stack */
+		err = copyin((userptr_t)tf->tf_sp + 16, &cfr_args[0],
+			     sizeof(cfr_args[0]));
+		if (err){
+			break;
+		}
+		err = sys_select((int)tf->tf_a0, (userptr_t)tf->tf_a1,
+				(userptr_t)tf->tf_a2, (userptr_t)tf->tf_a3,
+				(userptr_t)cfr_args[0], &retval);
+		break;
 
 		case SYS_lseek:
 		join32to64(tf->tf_a2, tf->tf_a3, &offset);
@@ -158,6 +298,7 @@ syscall(struct trapframe *tf)
 		break;
 	}
 
+	sysstats_record(callno, &start, err);
 
 	if (err) {
 		/*
@@ -194,13 +335,21 @@ syscall(struct trapframe *tf)
 /*
  * Enter user mode for a newly forked process.
  *
- * This function is provided as a reminder. You need to write
- * both it and the code that calls it.
- *
- * Thus, you can trash it and do things another way if you prefer.
+ * TF is the kmalloc'd copy of the parent's trapframe made by
+ * sys_fork. Move it onto this thread's stack, free it, and return
+ * 0 from fork.
  */
 void
 enter_forked_process(struct trapframe *tf)
 {
-	(void)tf;
+	struct trapframe mytf;
+
+	mytf = *tf;
+	kfree(tf);
+
+	mytf.tf_v0 = 0;
+	mytf.tf_a3 = 0;      /* signal no error */
+	mytf.tf_epc += 4;
+
+	mips_usermode(&mytf);
 }
@@ -229,10 +229,6 @@ cpu_irqoff(void)
         SET_STATUS(x);
 }
 
-/*
- * Used below.
- */
-static
 void
 cpu_irqonoff(void)
 {
@@ -32,6 +32,12 @@
 #include <vm.h>
 #include <mainbus.h>
 #include <spinlock.h>
+#include <spl.h>
+#include <atomic.h>
+#include <cpu.h>
+#include <current.h>
+#include <platform/maxcpus.h>
+#include <sysstats.h>
 
 vaddr_t firstfree;   /* first free virtual address; set by start.S */
 
@@ -43,6 +49,11 @@ static paddr_t lastpaddr;   /* one past end of last free physical page */
 typedef struct ft_entry {
         unsigned allocated:1; /* the corresponding frame is allocated */
         unsigned not_last:1; /* the frame is part of a multiframe allocation */
+        unsigned free_block:1; /* the frame heads a free buddy block */
+        unsigned order:5; /* and that block is 2^order frames */
+        volatile unsigned refcount; /* references to an allocated block */
+        uint32_t prev; /* free list links, as frame numbers; 0 ends */
+        uint32_t next; /* the list (frame 0 is never free) */
 } ft_entry_t;
 
 
@@ -50,6 +61,25 @@ static ft_entry_t * frame_table = NULL; /* base of frame table */
 static uint32_t first_frame;
 static uint32_t last_frame;
 
+/*
+ * Free frames are managed by a binary buddy allocator. A free block
+ * of order k is 2^k frames starting at a frame number that is a
+ * multiple of 2^k; its buddy is the block it was split from, the
+ * one whose frame number differs only in bit k. Free blocks are kept
+ * on a doubly linked list per order, threaded through the frame
+ * table, so a block can be taken off its list in constant time when
+ * its buddy is freed and the two are merged.
+ *
+ * An allocation of n frames takes a block of the smallest order that
+ * fits, splitting larger blocks as needed, and gives back the unused
+ * tail straight away, so it holds exactly n frames. 512M of RAM is
+ * 2^17 frames, so there are at most 18 orders.
+ */
+#define BUDDY_ORDERS 18
+
+static uint32_t free_heads[BUDDY_ORDERS]; /* first free block, or 0 */
+static uint32_t free_blocks[BUDDY_ORDERS]; /* number of free blocks */
+
 #define PAGE_BITS 12
 #define TRUE 1
 #define FALSE 0
@@ -61,6 +91,148 @@ static uint32_t last_frame;
 
 static struct spinlock frame_table_spinlock = SPINLOCK_INITIALIZER;
 
+/*
+ * Per-CPU magazines of free single frames in front of the buddy
+ * allocator. Single-page allocations and frees go to the current
+ * CPU's magazine, which only ever gets its own lock taken by another
+ * CPU when memory runs short and frame_drain empties every magazine,
+ * so the common case shares nothing. An empty magazine is refilled,
+ * and a full one drained, MAG_BATCH frames at a time under
+ * frame_table_spinlock.
+ *
+ * Frames in a magazine are allocated as far as the buddy allocator
+ * is concerned, with a reference count of zero.
+ */
+#define MAG_SIZE 32
+#define MAG_BATCH 16
+
+struct frame_magazine {
+        struct spinlock fm_lock;
+        unsigned fm_count;
+        uint32_t fm_frames[MAG_SIZE];
+        uint32_t fm_hits; /* allocations served from the magazine */
+        uint32_t fm_refills; /* trips to the buddy lists to refill */
+};
+
+static struct frame_magazine magazines[MAXCPUS];
+
+/*
+ * Pool of frames zeroed ahead of time by idle CPUs, for pages that
+ * have to start out zero-filled. It is capped at ZEROPOOL_MAX frames
+ * and at a sixteenth of RAM, and frame_drain empties it.
+ */
+#define ZEROPOOL_MAX 64
+
+static struct spinlock zeropool_lock = SPINLOCK_INITIALIZER;
+static uint32_t zeropool[ZEROPOOL_MAX];
+static unsigned zeropool_count;
+static unsigned zeropool_limit;
+static uint32_t zeropool_hits;  /* zeroed pages served from the pool */
+static uint32_t zeropool_misses; /* and zeroed on the spot */
+
+/* put the free block at frame i on the order list */
+static void freelist_push(unsigned order, uint32_t i)
+{
+        frame_table[i].free_block = TRUE;
+        frame_table[i].order = order;
+        frame_table[i].prev = 0;
+        frame_table[i].next = free_heads[order];
+        if (free_heads[order] != 0) {
+                frame_table[free_heads[order]].prev = i;
+        }
+        free_heads[order] = i;
+        free_blocks[order]++;
+}
+
+/* take the free block at frame i off its list, wherever it is */
+static void freelist_remove(uint32_t i)
+{
+        unsigned order = frame_table[i].order;
+        uint32_t prev = frame_table[i].prev;
+        uint32_t next = frame_table[i].next;
+
+        KASSERT(frame_table[i].free_block == TRUE);
+
+        if (prev != 0) {
+                frame_table[prev].next = next;
+        }
+        else {
+                free_heads[order] = next;
+        }
+        if (next != 0) {
+                frame_table[next].prev = prev;
+        }
+        frame_table[i].free_block = FALSE;
+        free_blocks[order]--;
+}
+
+/* free the block of 2^order frames at i, merging it with its buddies */
+static void buddy_free_block(uint32_t i, unsigned order)
+{
+        uint32_t buddy;
+
+        while (order < BUDDY_ORDERS - 1) {
+                buddy = i ^ (1 << order);
+                if (buddy < first_frame || buddy + (1 << order) > last_frame) {
+                        break;
+                }
+                if (frame_table[buddy].free_block == FALSE ||
+                    frame_table[buddy].order != order) {
+                        break;
+                }
+                freelist_remove(buddy);
+                if (buddy < i) {
+                        i = buddy;
+                }
+                order++;
+        }
+        freelist_push(order, i);
+}
+
+/* free n frames from i, in the biggest aligned blocks that fit */
+static void buddy_free_range(uint32_t i, uint32_t n)
+{
+        unsigned order;
+
+        while (n > 0) {
+                order = 0;
+                while (order < BUDDY_ORDERS - 1 &&
+                       (i & ((2 << order) - 1)) == 0 &&
+                       (2U << order) <= n) {
+                        order++;
+                }
+                buddy_free_block(i, order);
+                i += 1 << order;
+                n -= 1 << order;
+        }
+}
+
+/* take a free block of 2^order frames; 0 if there is none */
+static uint32_t buddy_alloc(unsigned order)
+{
+        unsigned k;
+        uint32_t i;
+
+        for (k = order; k < BUDDY_ORDERS; k++) {
+                if (free_heads[k] != 0) {
+                        break;
+                }
+        }
+        if (k == BUDDY_ORDERS) {
+                return 0;
+        }
+
+        i = free_heads[k];
+        freelist_remove(i);
+
+        /* split it, putting the top halves back */
+        while (k > order) {
+                k--;
+                freelist_push(k, i + (1 << k));
+        }
+        return i;
+}
+
 /*
  * Called very early in system boot to figure out how much physical
  * RAM is available.
@@ -130,6 +302,8 @@ ram_bootstrap(void)
                 /* Mark as allocated as individual pages */
                 frame_table[i].allocated = TRUE;
                 frame_table[i].not_last = FALSE;
+                frame_table[i].free_block = FALSE;
+                frame_table[i].refcount = 1;
         }                                            
         
         /* 
@@ -140,6 +314,25 @@ ram_bootstrap(void)
         
         for (i = first_frame; i < (lastpaddr >> PAGE_BITS); i++) {
                 frame_table[i].allocated = FALSE;
+                frame_table[i].not_last = FALSE;
+                frame_table[i].free_block = FALSE;
+                frame_table[i].refcount = 0;
+        }
+        for (i = 0; i < BUDDY_ORDERS; i++) {
+                free_heads[i] = 0;
+                free_blocks[i] = 0;
+        }
+        buddy_free_range(first_frame, last_frame - first_frame);
+
+        for (i = 0; i < MAXCPUS; i++) {
+                spinlock_init(&magazines[i].fm_lock);
+                magazines[i].fm_count = 0;
+        }
+
+        zeropool_count = 0;
+        zeropool_limit = (last_frame - first_frame) / 16;
+        if (zeropool_limit > ZEROPOOL_MAX) {
+                zeropool_limit = ZEROPOOL_MAX;
         }
 
         
@@ -189,90 +382,158 @@ ram_getfirstfree(void)
 }
 
 /*
- * This is a relatively inefficient first-fit allocator. Single pages
- * always fit. Multiframe allocations can suffer from external
- * fragmentation. It is intended to be easy to understand and robust,
- * not efficient.
+ * Allocate npages contiguous frames from the buddy allocator,
+ * returning the tail of the block beyond npages.
  */
-
-
-static paddr_t alloc_one_frame(unsigned int npages)
+static paddr_t alloc_frames(unsigned int npages)
 {
-        unsigned int i;
+        unsigned int order;
+        uint32_t i, j;
 
-        /* 
-         * Just scan from the start of the frame_table array for an
-         * unallocated block
-         */
-        
-        KASSERT(npages == 1);
+        KASSERT(npages > 0);
+
+        order = 0;
+        while ((1U << order) < npages) {
+                order++;
+        }
+        if (order >= BUDDY_ORDERS) {
+                return (paddr_t) 0;
+        }
 
         spinlock_acquire(&frame_table_spinlock);
-        for (i =  first_frame; i < last_frame; i++) {
-                if (frame_table[i].allocated == FALSE) {
-                        frame_table[i].allocated = TRUE;
-                        frame_table[i].not_last = FALSE;
 
-                        spinlock_release(&frame_table_spinlock);
+        i = buddy_alloc(order);
+        if (i == 0) {
+                /* Did not find a big enough free block :-( */
+                spinlock_release(&frame_table_spinlock);
+                return (paddr_t) 0;
+        }
+        buddy_free_range(i + npages, (1 << order) - npages);
 
-                        return (paddr_t) (i << PAGE_BITS);
-                }
+        for (j = i; j < i + npages - 1; j++) {
+                frame_table[j].allocated = TRUE; /* mark frame allocated */
+                frame_table[j].not_last = TRUE;  /* as a contiguous block */
         }
-        
-        /* Did not find an unallocated frame :-( */
+        frame_table[j].allocated = TRUE;
+        frame_table[j].not_last = FALSE;
+        frame_table[i].refcount = 1;  /* the block's count */
 
         spinlock_release(&frame_table_spinlock);
-        return (paddr_t) 0;
+
+        return (paddr_t) (i << PAGE_BITS);
 }
 
-static paddr_t alloc_multiple_frames(unsigned int npages)
+/* give the block of frames at i back to the buddy allocator */
+static void release_frames(uint32_t i)
 {
-        unsigned int i,j;
+        uint32_t n;
 
+        KASSERT(spinlock_do_i_hold(&frame_table_spinlock));
 
-        /* scan from 'i' for the number of needed free frames. If an
-         * allocated frame is encountered, restart the scan from after
-         * that point.
-         */
-        
+        n = 0;
+        while (1) {
+                frame_table[i + n].allocated = FALSE;
+                if (frame_table[i + n].not_last == FALSE) {
+                        n++;
+                        break;
+                }
+                frame_table[i + n].not_last = FALSE;
+                n++;
+        }
+        buddy_free_range(i, n);
+}
+
+/*
+ * Move up to n frames between a magazine, whose lock is held, and
+ * the buddy lists.
+ */
+static void magazine_refill(struct frame_magazine *fm, unsigned n)
+{
+        uint32_t i;
 
         spinlock_acquire(&frame_table_spinlock);
+        while (n > 0 && fm->fm_count < MAG_SIZE) {
+                i = buddy_alloc(0);
+                if (i == 0) {
+                        break;
+                }
+                frame_table[i].allocated = TRUE;
+                frame_table[i].not_last = FALSE;
+                frame_table[i].refcount = 0;
+                fm->fm_frames[fm->fm_count++] = i;
+                n--;
+        }
+        spinlock_release(&frame_table_spinlock);
+        fm->fm_refills++;
+}
 
-        i = first_frame; j = 0;
+static void magazine_drain(struct frame_magazine *fm, unsigned n)
+{
+        spinlock_acquire(&frame_table_spinlock);
+        while (n > 0 && fm->fm_count > 0) {
+                release_frames(fm->fm_frames[--fm->fm_count]);
+                n--;
+        }
+        spinlock_release(&frame_table_spinlock);
+}
 
-        while (i < (last_frame - npages) && j < npages) {
-                if (frame_table[i+j].allocated == TRUE) {
-                        i = i + j + 1; /* continue scan after allocated frame */
-                        j = 0;         /* restart the count */
-                }
-                else {
-                        j = j + 1; /* increment count of free frames */
-                }
+/*
+ * The current CPU's magazine, locked, or NULL this early in boot.
+ * The spl is raised first so the thread stays on this CPU.
+ */
+static struct frame_magazine *magazine_get(int *spl)
+{
+        struct frame_magazine *fm;
+
+        if (!CURCPU_EXISTS()) {
+                return NULL;
         }
+        *spl = splhigh();
+        fm = &magazines[curcpu->c_number];
+        spinlock_acquire(&fm->fm_lock);
+        return fm;
+}
 
-        if  (j == npages) { /* we exited as we found the number of frames required. */
-                for (j = i; j < i + npages - 1; j++) {
-                        frame_table[j].allocated = TRUE; /* mark frame allocated */
-                        frame_table[j].not_last = TRUE;  /* as a contiguous block */
-                }
-                frame_table[j].allocated = TRUE;
-                frame_table[j].not_last = FALSE;
+static void magazine_put(struct frame_magazine *fm, int spl)
+{
+        spinlock_release(&fm->fm_lock);
+        splx(spl);
+}
 
-                spinlock_release(&frame_table_spinlock);
-                
-                return (paddr_t) (i << PAGE_BITS);
+/* a single frame, from this CPU's magazine if it can be */
+static paddr_t alloc_one_frame(void)
+{
+        struct frame_magazine *fm;
+        uint32_t i;
+        int spl;
+
+        fm = magazine_get(&spl);
+        if (fm == NULL) {
+                return alloc_frames(1);
         }
-        
-        /* Did not find an unallocated contiguous range of frames :-( */
+        if (fm->fm_count == 0) {
+                magazine_refill(fm, MAG_BATCH);
+                if (fm->fm_count == 0) {
+                        magazine_put(fm, spl);
+                        return (paddr_t) 0;
+                }
+        }
+        else {
+                fm->fm_hits++;
+        }
+        i = fm->fm_frames[--fm->fm_count];
+        frame_table[i].refcount = 1;
+        magazine_put(fm, spl);
 
-        spinlock_release(&frame_table_spinlock);
-        return (paddr_t) 0;
+        return (paddr_t) (i << PAGE_BITS);
 }
 
 static void free_frames(vaddr_t vaddr)
 {
+        struct frame_magazine *fm;
         paddr_t paddr;
         uint32_t i;
+        int spl;
 
         KASSERT(vaddr != (vaddr_t) NULL);
 
@@ -280,33 +541,185 @@ static void free_frames(vaddr_t vaddr)
 
         i = paddr >> PAGE_BITS;
 
-        spinlock_acquire(&frame_table_spinlock);
-
         if (frame_table[i].allocated == FALSE) { /* check for double free error */
                 panic("Double free error!!");
         }
-        
-        while (frame_table[i].allocated == TRUE) { /* otherwise mark block free */
-                frame_table[i].allocated = FALSE;
-                if (frame_table[i].not_last == TRUE) {
-                        i++;
+        /* frames in a magazine are allocated, but with no references */
+        if (frame_table[i].refcount == 0) {
+                panic("Double free error!!");
+        }
+
+        if (atomic_add(&frame_table[i].refcount, -1) > 0) {
+                return; /* still shared */
+        }
+
+        /* single frames go back in this CPU's magazine */
+        if (frame_table[i].not_last == FALSE) {
+                fm = magazine_get(&spl);
+                if (fm != NULL) {
+                        if (fm->fm_count == MAG_SIZE) {
+                                magazine_drain(fm, MAG_BATCH);
+                        }
+                        fm->fm_frames[fm->fm_count++] = i;
+                        magazine_put(fm, spl);
+                        return;
                 }
         }
+
+        spinlock_acquire(&frame_table_spinlock);
+        release_frames(i);
         spinlock_release(&frame_table_spinlock);
 }
+
+/*
+ * Empty every CPU's magazine back into the buddy lists, so frames
+ * parked there can be used elsewhere or merged into larger blocks.
+ */
+void
+frame_drain(void)
+{
+        struct frame_magazine *fm;
+        uint32_t i;
+        unsigned n;
+
+        /* the zeroed pages first, so they land in the magazines */
+        while (1) {
+                spinlock_acquire(&zeropool_lock);
+                if (zeropool_count == 0) {
+                        spinlock_release(&zeropool_lock);
+                        break;
+                }
+                i = zeropool[--zeropool_count];
+                spinlock_release(&zeropool_lock);
+                free_frames(PADDR_TO_KVADDR(i << PAGE_BITS));
+        }
+
+        for (n = 0; n < MAXCPUS; n++) {
+                fm = &magazines[n];
+                spinlock_acquire(&fm->fm_lock);
+                magazine_drain(fm, MAG_SIZE);
+                spinlock_release(&fm->fm_lock);
+        }
+}
+
+/*
+ * Called from the idle loop: zero one free frame into the zero pool.
+ * Returns true if it did, false if the pool is full or there are no
+ * frames to spare, in which case the CPU might as well sleep.
+ */
+bool
+frame_zero_idle(void)
+{
+        paddr_t paddr;
+
+        if (zeropool_count >= zeropool_limit) {
+                return false;
+        }
+        /* not alloc_kpages: don't drain the magazines to fill the pool */
+        paddr = alloc_one_frame();
+        if (paddr == 0) {
+                return false;
+        }
+        bzero((void *)PADDR_TO_KVADDR(paddr), PAGE_SIZE);
+
+        spinlock_acquire(&zeropool_lock);
+        if (zeropool_count < zeropool_limit) {
+                zeropool[zeropool_count++] = paddr >> PAGE_BITS;
+                paddr = 0;
+        }
+        spinlock_release(&zeropool_lock);
+
+        if (paddr != 0) {
+                /* another CPU filled it first */
+                free_frames(PADDR_TO_KVADDR(paddr));
+        }
+        return true;
+}
+
+/*
+ * One zero-filled page, from the zero pool if it has any.
+ */
+vaddr_t
+alloc_zeroed_kpage(void)
+{
+        vaddr_t vaddr;
+        uint32_t i;
+
+        spinlock_acquire(&zeropool_lock);
+        if (zeropool_count > 0) {
+                i = zeropool[--zeropool_count];
+                zeropool_hits++;
+                spinlock_release(&zeropool_lock);
+                return PADDR_TO_KVADDR(i << PAGE_BITS);
+        }
+        zeropool_misses++;
+        spinlock_release(&zeropool_lock);
+
+        vaddr = alloc_kpages(1);
+        if (vaddr != 0) {
+                bzero((void *)vaddr, PAGE_SIZE);
+        }
+        return vaddr;
+}
+
+/*
+ * Per-frame reference counts, so one frame can back pages in more
+ * than one place. alloc_kpages hands out a block with one reference
+ * and free_kpages drops one.
+ */
+void
+frame_incref(paddr_t paddr)
+{
+        uint32_t i = paddr >> PAGE_BITS;
+
+        KASSERT(frame_table[i].allocated == TRUE);
+        KASSERT(frame_table[i].refcount > 0);
+        atomic_add(&frame_table[i].refcount, 1);
+}
+
+unsigned
+frame_refcount(paddr_t paddr)
+{
+        return frame_table[paddr >> PAGE_BITS].refcount;
+}
+
+/*
+ * Free frames in the buddy lists, the magazines and the zero pool.
+ * Read without the locks, so only an estimate.
+ */
+unsigned
+frame_nfree(void)
+{
+        unsigned k, n;
+
+        n = zeropool_count;
+        for (k = 0; k < BUDDY_ORDERS; k++) {
+                n += free_blocks[k] << k;
+        }
+        for (k = 0; k < MAXCPUS; k++) {
+                n += magazines[k].fm_count;
+        }
+        return n;
+}
         
 /* Allocate/free some kernel-space virtual pages */
 vaddr_t
 alloc_kpages(unsigned npages)
 {
         paddr_t paddr;
-        if (npages > 1 ) {
-                paddr = alloc_multiple_frames(npages);
+
+        if (npages == 1) {
+                paddr = alloc_one_frame();
         }
         else {
-                paddr = alloc_one_frame(npages);
+                paddr = alloc_frames(npages);
         }
-        
+        if (paddr == 0) {
+                /* frames may be sitting in other CPUs' magazines */
+                frame_drain();
+                paddr = alloc_frames(npages);
+        }
+
 	if (paddr == 0) {
 		return 0;
 	}
@@ -319,3 +732,69 @@ free_kpages(vaddr_t addr)
         free_frames(addr);
 }
 
+/*
+ * Format the buddy allocator's free lists as text into BUF, which has
+ * room for LEN bytes, returning the length of the whole text.
+ */
+size_t
+frame_stats_format(char *buf, size_t len)
+{
+        uint32_t blocks[BUDDY_ORDERS];
+        uint32_t nfree, total, cached, hits, refills;
+        unsigned k, largest;
+        size_t pos = 0;
+
+        /* snapshot, so the lock is not held across the formatting */
+        spinlock_acquire(&frame_table_spinlock);
+        for (k = 0; k < BUDDY_ORDERS; k++) {
+                blocks[k] = free_blocks[k];
+        }
+        spinlock_release(&frame_table_spinlock);
+
+        /* racy reads; only for the stats */
+        cached = hits = refills = 0;
+        for (k = 0; k < MAXCPUS; k++) {
+                cached += magazines[k].fm_count;
+                hits += magazines[k].fm_hits;
+                refills += magazines[k].fm_refills;
+        }
+
+        total = last_frame - first_frame;
+        nfree = 0;
+        largest = 0;
+        for (k = 0; k < BUDDY_ORDERS; k++) {
+                nfree += blocks[k] << k;
+                if (blocks[k] != 0) {
+                        largest = 1 << k;
+                }
+        }
+
+        SYSSTATS_PRINTF(buf, len, pos,
+                        "%u of %u frames free, largest free block %u frames\n",
+                        nfree, total, largest);
+        SYSSTATS_PRINTF(buf, len, pos,
+                        "%u more in per-CPU magazines; %u hits, %u refills\n",
+                        cached, hits, refills);
+        SYSSTATS_PRINTF(buf, len, pos,
+                        "%u in the zero pool; %u hits, %u misses\n",
+                        zeropool_count, zeropool_hits, zeropool_misses);
+        SYSSTATS_PRINTF(buf, len, pos, "%5s %7s %7s\n",
+                        "order", "frames", "free");
+        for (k = 0; k < BUDDY_ORDERS; k++) {
+                if ((1U << k) > total) {
+                        break;
+                }
+                SYSSTATS_PRINTF(buf, len, pos, "%5u %7u %7u\n",
+                                k, 1U << k, blocks[k]);
+        }
+        return pos;
+}
+
+void
+frame_printstats(void)
+{
+        char buf[1024];
+
+        frame_stats_format(buf, sizeof(buf));
+        kprintf("Frame allocator status:\n%s", buf);
+}
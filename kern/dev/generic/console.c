@@ -55,6 +55,7 @@
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
+#include <poll.h>
 #include <generic/console.h>
 #include <vfs.h>
 #include <device.h>
@@ -174,6 +175,13 @@ con_input(void *vcs, int ch)
 	cs->cs_gotchars_head = nexthead;
 
 	V(cs->cs_rsem);
+
+	/* a finished line (or a full buffer) makes reads not block */
+	if (ch == '\r' || ch == '\n' ||
+	    (nexthead + 1) % CONSOLE_INPUT_BUFFER_SIZE ==
+	    cs->cs_gotchars_tail) {
+		poll_wakeup();
+	}
 }
 
 /*
@@ -302,10 +310,45 @@ con_ioctl(struct device *dev, int op, userptr_t data)
 	return EINVAL;
 }
 
+/*
+ * Reads return at the end of a line, so the console is only readable
+ * without blocking once a whole line (or a full buffer's worth) has
+ * been typed. Output never waits for long, so it is always writable.
+ */
+static
+int
+con_poll(struct device *dev, int events, int *revents)
+{
+	struct con_softc *cs = dev->d_data;
+	unsigned pos, head, tail;
+	bool readable = false;
+	char ch;
+
+	head = cs->cs_gotchars_head;
+	tail = cs->cs_gotchars_tail;
+	if ((head + 1) % CONSOLE_INPUT_BUFFER_SIZE == tail) {
+		readable = true;
+	}
+	for (pos = tail; pos != head && !readable;
+	     pos = (pos + 1) % CONSOLE_INPUT_BUFFER_SIZE) {
+		ch = cs->cs_gotchars[pos];
+		if (ch == '\r' || ch == '\n') {
+			readable = true;
+		}
+	}
+
+	*revents = events & POLLOUT;
+	if (readable) {
+		*revents |= events & POLLIN;
+	}
+	return 0;
+}
+
 static const struct device_ops console_devops = {
 	.devop_eachopen = con_eachopen,
 	.devop_io = con_io,
 	.devop_ioctl = con_ioctl,
+	.devop_poll = con_poll,
 };
 
 static
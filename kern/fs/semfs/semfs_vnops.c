@@ -38,6 +38,7 @@
 #include <current.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <poll.h>
 
 #include "semfs.h"
 
@@ -145,6 +146,8 @@ semfs_wakeup(struct semfs_sem *sem, unsigned newcount)
 	if (sem->sems_count > 0 || newcount == 0) {
 		return;
 	}
+	/* P() no longer blocks; let pollers know */
+	poll_wakeup();
 	if (newcount == 1) {
 		cv_signal(sem->sems_cv, sem->sems_lock);
 	}
@@ -255,6 +258,28 @@ semfs_write(struct vnode *vn, struct uio *uio)
 	return 0;
 }
 
+/*
+ * Poll. A P() (read) goes through without blocking while the count
+ * is nonzero; a V() (write) never blocks.
+ */
+static
+int
+semfs_poll(struct vnode *vn, int events, int *revents)
+{
+	struct semfs_vnode *semv = vn->vn_data;
+	struct semfs_sem *sem;
+
+	sem = semfs_getsem(semv);
+
+	*revents = events & POLLOUT;
+	lock_acquire(sem->sems_lock);
+	if (sem->sems_count > 0) {
+		*revents |= events & POLLIN;
+	}
+	lock_release(sem->sems_lock);
+	return 0;
+}
+
 /*
  * Truncate. Set the count to the specified value.
  *
@@ -666,6 +691,7 @@ static const struct vnode_ops semfs_dirops = {
 	.vop_mmap = vopfail_mmap_isdir,
 	.vop_truncate = vopfail_truncate_isdir,
 	.vop_namefile = semfs_namefile,
+	.vop_poll = vopdefault_poll,
 
 	.vop_creat = semfs_creat,
 	.vop_symlink = vopfail_symlink_nosys,
@@ -699,6 +725,7 @@ static const struct vnode_ops semfs_semops = {
 	.vop_mmap = vopfail_mmap_perm,
 	.vop_truncate = semfs_truncate,
 	.vop_namefile = vopfail_uio_notdir,
+	.vop_poll = semfs_poll,
 
 	.vop_creat = vopfail_creat_notdir,
 	.vop_symlink = vopfail_symlink_notdir,
@@ -221,15 +221,18 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 }
 
 /*
- * Do I/O (either read or write) of a single whole block.
+ * Do I/O (either read or write) of a run of whole blocks, at most
+ * MAXBLOCKS long. As many of the file's blocks as sit consecutively
+ * on disk are moved with a single DEVOP_IO; the caller loops until
+ * the whole-block part of the request is done.
  */
 static
 int
-sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
+sfs_blockio(struct sfs_vnode *sv, struct uio *uio, uint32_t maxblocks)
 {
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
-	daddr_t diskblock;
-	uint32_t fileblock;
+	daddr_t diskblock, nextblock;
+	uint32_t fileblock, nblocks;
 	int result;
 	bool doalloc = (uio->uio_rw==UIO_WRITE);
 	off_t saveoff;
@@ -237,6 +240,8 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 	off_t saveres;
 	off_t diskres;
 
+	KASSERT(maxblocks > 0);
+
 	/* Get the block number within the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
 
@@ -257,6 +262,19 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 		return uiomovezeros(SFS_BLOCKSIZE, uio);
 	}
 
+	/*
+	 * Extend the run while the following file blocks are the
+	 * following disk blocks. A failure here just ends the run;
+	 * the next call will run into it again and report it.
+	 */
+	for (nblocks = 1; nblocks < maxblocks; nblocks++) {
+		result = sfs_bmap(sv, fileblock + nblocks, doalloc,
+				  &nextblock);
+		if (result || nextblock != diskblock + nblocks) {
+			break;
+		}
+	}
+
 	/*
 	 * Do the I/O directly to the uio region. Save the uio_offset,
 	 * and substitute one that makes sense to the device.
@@ -266,11 +284,11 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 	uio->uio_offset = diskoff;
 
 	/*
-	 * Temporarily set the residue to be one block size.
+	 * Temporarily set the residue to the length of the run.
 	 */
-	KASSERT(uio->uio_resid >= SFS_BLOCKSIZE);
+	KASSERT(uio->uio_resid >= nblocks * SFS_BLOCKSIZE);
 	saveres = uio->uio_resid;
-	diskres = SFS_BLOCKSIZE;
+	diskres = nblocks * SFS_BLOCKSIZE;
 	uio->uio_resid = diskres;
 
 	result = sfs_rwblock(sfs, uio);
@@ -292,7 +310,7 @@ int
 sfs_io(struct sfs_vnode *sv, struct uio *uio)
 {
 	uint32_t blkoff;
-	uint32_t nblocks, i;
+	uint32_t nblocks;
 	int result = 0;
 	uint32_t origresid, extraresid = 0;
 
@@ -351,9 +369,9 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	 * Now we should be block-aligned. Do the remaining whole blocks.
 	 */
 	KASSERT(uio->uio_offset % SFS_BLOCKSIZE == 0);
-	nblocks = uio->uio_resid / SFS_BLOCKSIZE;
-	for (i=0; i<nblocks; i++) {
-		result = sfs_blockio(sv, uio);
+	while (uio->uio_resid >= SFS_BLOCKSIZE) {
+		nblocks = uio->uio_resid / SFS_BLOCKSIZE;
+		result = sfs_blockio(sv, uio, nblocks);
 		if (result) {
 			goto out;
 		}
@@ -0,0 +1,456 @@
+/*
+ * statsfs: a read-only pseudo-filesystem of kernel statistics,
+ * attached as "stats:" at boot the same way semfs is.
+ *
+ * There is one flat directory. Each file in it is a name and a
+ * function that formats the current statistics as text; every read
+ * formats a fresh copy and hands back the part at the read offset.
+ * All the vnodes are made at boot and never go away.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <vfs.h>
+#include <fs.h>
+#include <vnode.h>
+#include <vm.h>
+#include <swap.h>
+#include <pagecache.h>
+#include <sysstats.h>
+#include "opt-dumbvm.h"
+#include "opt-unsw.h"
+
+#define STATSFS_ROOTDIR	0xffffffffU		/* fileno for root dir */
+
+/*
+ * The files.
+ */
+struct statsfs_file {
+	const char *sf_name;
+	/* format into BUF of size LEN; returns the untruncated length */
+	size_t (*sf_format)(char *buf, size_t len);
+};
+
+static const struct statsfs_file statsfs_files[] = {
+	{ "syscalls", sysstats_format },
+#if !OPT_DUMBVM
+	{ "tlb", vm_tlbstats_format },
+	{ "swap", swap_stats_format },
+	{ "pagecache", pagecache_stats_format },
+#endif
+#if OPT_UNSW
+	{ "frames", frame_stats_format },
+#endif
+};
+#define STATSFS_NFILES \
+	(sizeof(statsfs_files) / sizeof(statsfs_files[0]))
+
+/*
+ * Vnode; FILENO is an index into statsfs_files, or STATSFS_ROOTDIR.
+ */
+struct statsfs_vnode {
+	struct vnode stv_absvn;
+	unsigned stv_fileno;
+};
+
+struct statsfs {
+	struct fs stfs_absfs;
+	struct statsfs_vnode stfs_root;
+	struct statsfs_vnode stfs_files[STATSFS_NFILES];
+};
+
+////////////////////////////////////////////////////////////
+// vnode ops
+
+static
+int
+statsfs_eachopen(struct vnode *vn, int openflags)
+{
+	(void)vn;
+
+	if ((openflags & O_ACCMODE) != O_RDONLY) {
+		return EROFS;
+	}
+	if (openflags & (O_CREAT | O_TRUNC | O_APPEND)) {
+		return EROFS;
+	}
+	return 0;
+}
+
+/*
+ * Everything lives as long as the filesystem does. Since the fs
+ * itself holds a reference to each vnode, this is never reached
+ * with the last reference.
+ */
+static
+int
+statsfs_reclaim(struct vnode *vn)
+{
+	(void)vn;
+	return EBUSY;
+}
+
+static
+int
+statsfs_read(struct vnode *vn, struct uio *uio)
+{
+	struct statsfs_vnode *stv = vn->vn_data;
+	const struct statsfs_file *sf = &statsfs_files[stv->stv_fileno];
+	char *buf;
+	size_t len, need;
+	int result;
+
+	KASSERT(uio->uio_offset >= 0);
+
+	/* the text can grow while we size it; go round until it fits */
+	len = 4096;
+	while (1) {
+		buf = kmalloc(len);
+		if (buf == NULL) {
+			return ENOMEM;
+		}
+		need = sf->sf_format(buf, len);
+		if (need < len) {
+			break;
+		}
+		kfree(buf);
+		len = need + 1;
+	}
+
+	result = 0;
+	if (uio->uio_offset < (off_t)need) {
+		result = uiomove(buf + uio->uio_offset,
+				 need - uio->uio_offset, uio);
+	}
+	kfree(buf);
+	return result;
+}
+
+static
+int
+statsfs_write(struct vnode *vn, struct uio *uio)
+{
+	(void)vn;
+	(void)uio;
+	return EROFS;
+}
+
+static
+int
+statsfs_ioctl(struct vnode *vn, int op, userptr_t data)
+{
+	(void)vn;
+	(void)op;
+	(void)data;
+	return EINVAL;
+}
+
+static
+int
+statsfs_stat(struct vnode *vn, struct stat *buf)
+{
+	struct statsfs_vnode *stv = vn->vn_data;
+
+	bzero(buf, sizeof(*buf));
+	if (stv->stv_fileno == STATSFS_ROOTDIR) {
+		buf->st_mode = S_IFDIR | 0555;
+		buf->st_nlink = 2;
+		buf->st_size = STATSFS_NFILES;
+	}
+	else {
+		/* the size isn't known until the file is read */
+		buf->st_mode = S_IFREG | 0444;
+		buf->st_nlink = 1;
+		buf->st_size = 0;
+	}
+	buf->st_ino = stv->stv_fileno;
+	return 0;
+}
+
+static
+int
+statsfs_gettype(struct vnode *vn, mode_t *ret)
+{
+	struct statsfs_vnode *stv = vn->vn_data;
+
+	*ret = stv->stv_fileno == STATSFS_ROOTDIR ? S_IFDIR : S_IFREG;
+	return 0;
+}
+
+static
+bool
+statsfs_isseekable(struct vnode *vn)
+{
+	(void)vn;
+	return true;
+}
+
+static
+int
+statsfs_fsync(struct vnode *vn)
+{
+	(void)vn;
+	return 0;
+}
+
+static
+int
+statsfs_truncate(struct vnode *vn, off_t len)
+{
+	(void)vn;
+	(void)len;
+	return EROFS;
+}
+
+/*
+ * Directory read: one name per call, by position.
+ */
+static
+int
+statsfs_getdirentry(struct vnode *dirvn, struct uio *uio)
+{
+	const char *name;
+
+	(void)dirvn;
+	KASSERT(uio->uio_offset >= 0);
+
+	if (uio->uio_offset >= (off_t)STATSFS_NFILES) {
+		/* EOF */
+		return 0;
+	}
+	name = statsfs_files[uio->uio_offset].sf_name;
+	return uiomove((char *)name, strlen(name), uio);
+}
+
+/*
+ * Backend for getcwd; there are no subdirs, so it's always the root.
+ */
+static
+int
+statsfs_namefile(struct vnode *vn, struct uio *uio)
+{
+	(void)vn;
+	(void)uio;
+	return 0;
+}
+
+static
+int
+statsfs_creat(struct vnode *dirvn, const char *name, bool excl, mode_t mode,
+	      struct vnode **resultvn)
+{
+	(void)dirvn;
+	(void)name;
+	(void)excl;
+	(void)mode;
+	(void)resultvn;
+	return EROFS;
+}
+
+static
+int
+statsfs_remove(struct vnode *dirvn, const char *name)
+{
+	(void)dirvn;
+	(void)name;
+	return EROFS;
+}
+
+static
+int
+statsfs_lookup(struct vnode *dirvn, char *path, struct vnode **resultvn)
+{
+	struct statsfs *stfs = dirvn->vn_fs->fs_data;
+	struct vnode *vn;
+	unsigned i;
+
+	if (!strcmp(path, ".") || !strcmp(path, "..")) {
+		vn = dirvn;
+		goto found;
+	}
+	for (i=0; i<STATSFS_NFILES; i++) {
+		if (!strcmp(path, statsfs_files[i].sf_name)) {
+			vn = &stfs->stfs_files[i].stv_absvn;
+			goto found;
+		}
+	}
+	return ENOENT;
+
+ found:
+	VOP_INCREF(vn);
+	*resultvn = vn;
+	return 0;
+}
+
+static
+int
+statsfs_lookparent(struct vnode *dirvn, char *path,
+		   struct vnode **resultdirvn, char *namebuf, size_t bufmax)
+{
+	if (strlen(path)+1 > bufmax) {
+		return ENAMETOOLONG;
+	}
+	strcpy(namebuf, path);
+
+	VOP_INCREF(dirvn);
+	*resultdirvn = dirvn;
+	return 0;
+}
+
+static const struct vnode_ops statsfs_dirops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = statsfs_eachopen,
+	.vop_reclaim = statsfs_reclaim,
+
+	.vop_read = vopfail_uio_isdir,
+	.vop_readlink = vopfail_uio_isdir,
+	.vop_getdirentry = statsfs_getdirentry,
+	.vop_write = vopfail_uio_isdir,
+	.vop_ioctl = statsfs_ioctl,
+	.vop_stat = statsfs_stat,
+	.vop_gettype = statsfs_gettype,
+	.vop_isseekable = statsfs_isseekable,
+	.vop_fsync = statsfs_fsync,
+	.vop_mmap = vopfail_mmap_isdir,
+	.vop_truncate = vopfail_truncate_isdir,
+	.vop_namefile = statsfs_namefile,
+	.vop_poll = vopdefault_poll,
+
+	.vop_creat = statsfs_creat,
+	.vop_symlink = vopfail_symlink_nosys,
+	.vop_mkdir = vopfail_mkdir_nosys,
+	.vop_link = vopfail_link_nosys,
+	.vop_remove = statsfs_remove,
+	.vop_rmdir = vopfail_string_nosys,
+	.vop_rename = vopfail_rename_nosys,
+	.vop_lookup = statsfs_lookup,
+	.vop_lookparent = statsfs_lookparent,
+};
+
+static const struct vnode_ops statsfs_fileops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = statsfs_eachopen,
+	.vop_reclaim = statsfs_reclaim,
+
+	.vop_read = statsfs_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = statsfs_write,
+	.vop_ioctl = statsfs_ioctl,
+	.vop_stat = statsfs_stat,
+	.vop_gettype = statsfs_gettype,
+	.vop_isseekable = statsfs_isseekable,
+	.vop_fsync = statsfs_fsync,
+	.vop_mmap = vopfail_mmap_perm,
+	.vop_truncate = statsfs_truncate,
+	.vop_namefile = vopfail_uio_notdir,
+	.vop_poll = vopdefault_poll,
+
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+////////////////////////////////////////////////////////////
+// fs ops
+
+static
+int
+statsfs_sync(struct fs *fs)
+{
+	(void)fs;
+	return 0;
+}
+
+static
+const char *
+statsfs_getvolname(struct fs *fs)
+{
+	(void)fs;
+	return "stats";
+}
+
+static
+int
+statsfs_getroot(struct fs *fs, struct vnode **ret)
+{
+	struct statsfs *stfs = fs->fs_data;
+
+	VOP_INCREF(&stfs->stfs_root.stv_absvn);
+	*ret = &stfs->stfs_root.stv_absvn;
+	return 0;
+}
+
+/*
+ * Attached at boot and never detached.
+ */
+static
+int
+statsfs_unmount(struct fs *fs)
+{
+	(void)fs;
+	return EBUSY;
+}
+
+static const struct fs_ops statsfs_fsops = {
+	.fsop_sync = statsfs_sync,
+	.fsop_getvolname = statsfs_getvolname,
+	.fsop_getroot = statsfs_getroot,
+	.fsop_unmount = statsfs_unmount,
+};
+
+static
+void
+statsfs_vnode_init(struct statsfs *stfs, struct statsfs_vnode *stv,
+		   const struct vnode_ops *ops, unsigned fileno)
+{
+	int result;
+
+	stv->stv_fileno = fileno;
+	/* this reference belongs to the fs and is never dropped */
+	result = vnode_init(&stv->stv_absvn, ops, &stfs->stfs_absfs, stv);
+	/* vnode_init doesn't actually fail */
+	KASSERT(result == 0);
+}
+
+/*
+ * Create the statsfs and attach it as "stats:".
+ */
+void
+statsfs_bootstrap(void)
+{
+	struct statsfs *stfs;
+	unsigned i;
+	int result;
+
+	stfs = kmalloc(sizeof(*stfs));
+	if (stfs == NULL) {
+		panic("Out of memory creating statsfs\n");
+	}
+	stfs->stfs_absfs.fs_data = stfs;
+	stfs->stfs_absfs.fs_ops = &statsfs_fsops;
+
+	statsfs_vnode_init(stfs, &stfs->stfs_root, &statsfs_dirops,
+			   STATSFS_ROOTDIR);
+	for (i=0; i<STATSFS_NFILES; i++) {
+		statsfs_vnode_init(stfs, &stfs->stfs_files[i],
+				   &statsfs_fileops, i);
+	}
+
+	result = vfs_addfs("stats", &stfs->stfs_absfs);
+	if (result) {
+		panic("Attaching statsfs: %s\n", strerror(result));
+	}
+}
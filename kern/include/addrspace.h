@@ -36,16 +36,47 @@
 
 
 #include <vm.h>
+#include <platform/maxcpus.h>
 #include "opt-dumbvm.h"
 
 struct vnode;
+struct pagetable;
 
+/*
+ * The user stack starts out one page long and grows down a page at a
+ * time as it is touched, up to a per-process limit: VM_STACKPAGES
+ * pages to begin with, which setrlimit can move up to VM_STACKMAX.
+ */
+#define VM_STACKPAGES 1024
+#define VM_STACKMAX   4096
+
+/* mmap places mappings it chooses the address of below the limit */
+#define VM_MMAPTOP(as) (USERSTACK - (as)->as_stackmax * PAGE_SIZE)
+
+/*
+ * A region is a range of pages the process may touch, as set up by
+ * as_define_region and as_define_stack and resized by as_sbrk and
+ * as_grow_stack. Pages in it are allocated on first touch. They are
+ * zero-filled, except for any part that as_map_file has backed with
+ * a file, which is read from it. A region made by as_mmap maps the
+ * file from rg_base on, through its page cache.
+ */
+struct region {
+        vaddr_t rg_base;
+        size_t rg_npages;
+        bool rg_write;                  /* writes allowed */
+        struct vnode *rg_vnode;         /* backing file, or NULL */
+        vaddr_t rg_filebase;            /* where the file data starts */
+        off_t rg_fileoff;               /* its offset in the file */
+        size_t rg_filesz;               /* and its length */
+        int rg_mmap;                    /* MAP_SHARED or MAP_PRIVATE if
+                                           made by as_mmap, else 0 */
+        struct region *rg_next;
+};
 
 /*
  * Address space - data structure associated with the virtual memory
  * space of a process.
- *
- * You write this.
  */
 
 struct addrspace {
@@ -58,7 +89,16 @@ struct addrspace {
         size_t as_npages2;
         paddr_t as_stackpbase;
 #else
-        /* Put stuff here for your VM system */
+        struct region *as_regions;      /* list of regions */
+        struct pagetable *as_pt;        /* what is resident where */
+        struct region *as_heap;         /* region sbrk moves the top of */
+        vaddr_t as_heapend;             /* the break, within its last page */
+        struct region *as_stack;        /* the stack region */
+        size_t as_stackmax;             /* pages it may grow to */
+        unsigned as_paging;             /* pages in transit to or from
+                                           swap (vm_lock) */
+        uint32_t as_asid[MAXCPUS];      /* per-CPU generation and ASID;
+                                           0 for none */
 #endif
 };
 
@@ -99,6 +139,33 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_grow_stack - if VADDR is below the stack but within its limit,
+ *                grow the stack down to take it in and return it;
+ *                otherwise return NULL.
+ *
+ *    as_find_region - return the region containing VADDR, or NULL.
+ *
+ *    as_map_file - back FILESIZE bytes of the region at VADDR with the
+ *                file VN from OFFSET on, to be read in a page at a
+ *                time as they are touched.
+ *
+ *    as_mmap   - map LEN bytes of VN from OFFSET on, as MAP_SHARED or
+ *                MAP_PRIVATE in FLAGS, at *VADDR if FLAGS has
+ *                MAP_FIXED or else at an address chosen below
+ *                the stack limit and handed back. FILESZ bytes of it are
+ *                in the file. Takes over the caller's reference to VN.
+ *
+ *    as_munmap - unmap whatever as_mmap has mapped from VADDR to
+ *                VADDR+LEN, writing shared pages back first.
+ *
+ *    as_msync  - write back the written pages of the shared mappings
+ *                from VADDR to VADDR+LEN, all of which must be mapped.
+ *
+ *    as_sbrk   - move the heap break by AMOUNT, handing back the old
+ *                one. Only the heap region's size changes: pages
+ *                above a lowered break are freed, and pages below a
+ *                raised one are zero-filled when first touched.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -117,6 +184,20 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+struct region    *as_find_region(struct addrspace *as, vaddr_t vaddr);
+struct region    *as_grow_stack(struct addrspace *as, vaddr_t vaddr);
+int               as_map_file(struct addrspace *as, vaddr_t vaddr,
+                              size_t filesize, struct vnode *vn,
+                              off_t offset);
+int               as_mmap(struct addrspace *as, vaddr_t *vaddr,
+                          size_t len, bool write, int flags,
+                          struct vnode *vn, off_t offset, size_t filesz);
+int               as_munmap(struct addrspace *as, vaddr_t vaddr,
+                            size_t len);
+int               as_msync(struct addrspace *as, vaddr_t vaddr,
+                           size_t len);
+int               as_sbrk(struct addrspace *as, intptr_t amount,
+                          vaddr_t *oldbreak);
 
 
 /*
@@ -0,0 +1,32 @@
+#ifndef _ATOMIC_H_
+#define _ATOMIC_H_
+
+/*
+ * Atomic read-modify-write operations on a single machine word, for
+ * counters that are touched on hot paths where taking a lock would
+ * cost more than the work being protected.
+ *
+ * atomic_add adds DELTA to *P and returns the new value.
+ *
+ * atomic_inc_not_zero adds one to *P unless it is zero, and returns
+ * the value it found. This is the operation needed to take a new
+ * reference on an object found through a pointer that does not
+ * itself hold one: once the count has reached zero the object is
+ * on its way to being reused and must be left alone.
+ *
+ * Like the spinlock operations, these include whatever memory
+ * barriers they need to order the update itself, but nothing more.
+ */
+
+/* Inlining support - for making sure an out-of-line copy gets built */
+#ifndef ATOMIC_INLINE
+#define ATOMIC_INLINE INLINE
+#endif
+
+ATOMIC_INLINE unsigned atomic_add(volatile unsigned *p, int delta);
+ATOMIC_INLINE unsigned atomic_inc_not_zero(volatile unsigned *p);
+
+/* Get the implementation. */
+#include <machine/atomic.h>
+
+#endif /* _ATOMIC_H_ */
@@ -61,6 +61,7 @@ struct cpu {
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
+	struct sysstats *c_sysstats;	/* Syscall counters (read by all) */
 
 	/*
 	 * Accessed by other cpus.
@@ -125,6 +126,12 @@ void cpu_identify(char *buf, size_t max);
 void cpu_irqoff(void);
 void cpu_irqon(void);
 
+/*
+ * Turn interrupts on just long enough to take any that are pending,
+ * and off again. For the idle loop, which runs with them off.
+ */
+void cpu_irqonoff(void);
+
 /*
  * Idle or shut down (respectively) the processor.
  *
@@ -155,6 +162,8 @@ void cpu_halt(void);
  * ipi_send sends an IPI to one CPU.
  * ipi_broadcast sends an IPI to all CPUs except the current one.
  * ipi_tlbshootdown is like ipi_send but carries TLB shootdown data.
+ * ipi_tlbshootdown_cpus sends it to the CPUs whose c_number bits are
+ * set in CPUS, except the current one, and returns how many that was.
  *
  * interprocessor_interrupt is called on the target CPU when an IPI is
  * received.
@@ -169,6 +178,8 @@ void cpu_halt(void);
 void ipi_send(struct cpu *target, int code);
 void ipi_broadcast(int code);
 void ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping);
+unsigned ipi_tlbshootdown_cpus(uint32_t cpus,
+			       const struct tlbshootdown *mapping);
 
 void interprocessor_interrupt(void);
 
@@ -14,18 +14,45 @@
 #define FILE_CLOSED -1
 
 
+/* number of open files carved out of each open file table slab */
+#define OFT_SLAB_FILES 32
+
+/* slab pointers in each open file table directory */
+#define OFT_DIR_SLABS 64
+
+/* most directories the open file table can grow to (131072 files) */
+#define OFT_MAX_DIRS 64
+
+/* words in the per-process descriptor bitmap */
+#define FD_BITMAP_WORDS ((OPEN_MAX + 31) / 32)
+
 /* global open file table entry */
 struct open_file{
 	struct vnode *vnode;	/* the vnode this file represents */
-	int refcount;			/* the reference count of this file */
+	volatile unsigned refcount;	/* fds and I/O using this file (atomic) */
+	struct lock *of_lock;	/* protects offset across a whole read/write */
 	off_t offset;		/* read offset within the file */
 	int accmode;       /* access mode for cur open file*/
+	int of_index;		/* slot of this file in the open file table */
+	struct open_file *of_next;	/* free list link (oft_lock) */
 };
 
-/* global open file table */
+/*
+ * global open file table
+ *
+ * Entries live in slabs of OFT_SLAB_FILES that are added on demand
+ * and never freed. The slab pointers sit in directories of
+ * OFT_DIR_SLABS, also allocated as needed and never freed, whose
+ * pointers sit in a fixed array; so an entry's address and of_index
+ * are stable and can be looked up without any lock. An entry whose refcount drops to zero is not
+ * freed but put back on the free list for reuse. Allocating a slot
+ * is O(1) no matter how many files are open system-wide.
+ */
 struct file_table{
-	struct lock *oft_lock;	/* open file table lock */
-	struct open_file *openfiles[OPEN_MAX];	/* array of open files pointer */
+	struct lock *oft_lock;	/* protects slab and free list changes */
+	struct open_file **dirs[OFT_MAX_DIRS];	/* OFT_DIR_SLABS slabs each */
+	unsigned nslabs;		/* number of slabs in use */
+	struct open_file *freelist;	/* entries with refcount 0 */
 };
 
 /* global open file table */
@@ -37,6 +64,14 @@ int open_file_table_init(void);
 /* initiate fd_table for each proc */
 int fd_table_init(void);
 
+struct proc;
+
+/* give a forked child the current process's descriptors */
+void fd_table_copy(struct proc *child);
+
+/* close every descriptor of a process that is going away */
+void fd_table_destroy(struct proc *proc);
+
 
 int sys_open(char *filename, int flags, mode_t mode, int32_t *retval);
 
@@ -44,11 +79,37 @@ int sys_close(int fd);
 
 int sys_dup2(int oldfd, int newfd, int *retval);
 
+int sys_pipe(userptr_t fds, int32_t *retval);
+
 int sys_write(int fd, const void *buf, size_t nbytes, int32_t *retval);
 
 int sys_read(int fd, const void *buf, size_t nbytes, int *retval);
 
+int sys_pread(int fd, void *buf, size_t nbytes, off_t pos, int32_t *retval);
+
+int sys_pwrite(int fd, const void *buf, size_t nbytes, off_t pos,
+    int32_t *retval);
+
+int sys_readv(int fd, userptr_t iov, int iovcnt, int32_t *retval);
+
+int sys_writev(int fd, userptr_t iov, int iovcnt, int32_t *retval);
+
+int sys_preadv(int fd, userptr_t iov, int iovcnt, off_t pos,
+    int32_t *retval);
+
+int sys_pwritev(int fd, userptr_t iov, int iovcnt, off_t pos,
+    int32_t *retval);
+
+int sys_copy_file_range(int infd, userptr_t inpos, int outfd,
+    userptr_t outpos, size_t len, unsigned flags, int32_t *retval);
+
 int sys_lseek(int fd, off_t pos, int whence, off_t *retval64);
 
+/* VOP_POLL on the file behind fd, for poll() and select() */
+int file_poll(int fd, int events, int *revents);
+
+/* the vnode behind fd, referenced, and its size, for mmap() */
+int file_mmap(int fd, bool write, struct vnode **ret, off_t *size);
+
 
 #endif /* _FILE_H_ */
@@ -86,6 +86,7 @@ struct fs_ops {
 
 /* Initialization functions for builtin fake file systems. */
 void semfs_bootstrap(void);
+void statsfs_bootstrap(void);
 
 
 #endif /* _FS_H_ */
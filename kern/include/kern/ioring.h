@@ -0,0 +1,67 @@
+#ifndef _KERN_IORING_H_
+#define _KERN_IORING_H_
+
+/*
+ * Shared layout of a batched I/O submission ring (ioring_setup(),
+ * ioring_enter()).
+ *
+ * The ring lives in ordinary user memory that the process registers
+ * once with ioring_setup(). It is a struct ioring header followed by
+ * ir_entries submission entries and then ir_entries completion
+ * entries; IORING_SIZE() gives the total size. The user fills in
+ * sqes and advances ir_sq_tail, then calls ioring_enter() to run up
+ * to that many requests in one trap. The kernel advances ir_sq_head
+ * and ir_cq_tail; the user reaps completions straight out of memory
+ * and advances ir_cq_head without trapping.
+ *
+ * Head and tail are free-running counters; index a ring by masking
+ * with (ir_entries - 1). ir_entries must be a power of two no larger
+ * than IORING_MAX_ENTRIES, and the ring must be 8-byte aligned.
+ */
+
+/* Request codes for sqe_op */
+#define IORING_OP_NOP     0      /* Do nothing; completes with 0 */
+#define IORING_OP_READ    1      /* read(fd, addr, len) */
+#define IORING_OP_WRITE   2      /* write(fd, addr, len) */
+#define IORING_OP_LSEEK   3      /* lseek(fd, off, flags) */
+#define IORING_OP_OPEN    4      /* open(addr, len) */
+#define IORING_OP_CLOSE   5      /* close(fd) */
+
+/* Flags for sqe_flags on READ and WRITE */
+#define IORING_F_POS      1      /* Use sqe_off, like pread/pwrite */
+
+#define IORING_MAX_ENTRIES 256
+
+struct ioring_sqe {
+	__i64 sqe_off;		/* Position for IORING_F_POS, or seek offset */
+	__u32 sqe_op;		/* IORING_OP_* */
+	__i32 sqe_fd;		/* File handle */
+	__u32 sqe_addr;		/* Buffer, or pathname for OPEN */
+	__u32 sqe_len;		/* Byte count, or open flags for OPEN */
+	__u32 sqe_flags;	/* IORING_F_*, or whence for LSEEK */
+	__u32 sqe_data;		/* Cookie copied to the completion */
+};
+
+struct ioring_cqe {
+	__i64 cqe_res;		/* Return value, or -errno on failure */
+	__u32 cqe_data;		/* sqe_data of the request */
+	__u32 cqe_pad;
+};
+
+struct ioring {
+	__u32 ir_sq_head;	/* Next sqe the kernel takes (kernel) */
+	__u32 ir_sq_tail;	/* One past the last queued sqe (user) */
+	__u32 ir_cq_head;	/* Next cqe the user reaps (user) */
+	__u32 ir_cq_tail;	/* One past the last posted cqe (kernel) */
+	__u32 ir_entries;	/* Slots in each ring (set by ioring_setup) */
+	__u32 ir_pad;
+};
+
+#define IORING_SQ_OFFSET	(sizeof(struct ioring))
+#define IORING_CQ_OFFSET(n)	(IORING_SQ_OFFSET + \
+				 (n) * sizeof(struct ioring_sqe))
+#define IORING_SIZE(n)		(IORING_CQ_OFFSET(n) + \
+				 (n) * sizeof(struct ioring_cqe))
+
+
+#endif /* _KERN_IORING_H_ */
@@ -0,0 +1,30 @@
+#ifndef _KERN_MMAN_H_
+#define _KERN_MMAN_H_
+
+/*
+ * Definitions for mmap(), munmap() and msync().
+ */
+
+/* protection, for mmap's prot argument */
+#define PROT_NONE	0x0
+#define PROT_READ	0x1
+#define PROT_WRITE	0x2
+#define PROT_EXEC	0x4
+
+/* mapping type, for mmap's flags argument; one of these is required */
+#define MAP_SHARED	0x1	/* writes go to the file */
+#define MAP_PRIVATE	0x2	/* writes stay in the process */
+#define MAP_TYPE	0x3
+
+/* also in flags: ADDR is the address to use, not just a hint */
+#define MAP_FIXED	0x10
+
+/* what mmap returns on error */
+#define MAP_FAILED	((void *)-1)
+
+/* flags for msync */
+#define MS_ASYNC	0x1	/* (writes back synchronously anyway) */
+#define MS_SYNC		0x2
+#define MS_INVALIDATE	0x4	/* (nothing to invalidate) */
+
+#endif /* _KERN_MMAN_H_ */
@@ -0,0 +1,26 @@
+#ifndef _KERN_POLL_H_
+#define _KERN_POLL_H_
+
+/*
+ * Definitions for poll().
+ *
+ * For each struct pollfd the caller sets fd and the conditions of
+ * interest in events; poll() fills in revents with the ones that
+ * hold. POLLERR, POLLHUP and POLLNVAL are always reported and need
+ * not be asked for. Entries with a negative fd are skipped.
+ */
+
+struct pollfd {
+	int fd;			/* descriptor to check */
+	short events;		/* conditions wanted */
+	short revents;		/* conditions found */
+};
+
+#define POLLIN		0x0001	/* Data can be read without blocking */
+#define POLLPRI		0x0002	/* Urgent data can be read (never set) */
+#define POLLOUT		0x0004	/* Data can be written without blocking */
+#define POLLERR		0x0008	/* An error is pending */
+#define POLLHUP		0x0010	/* The other end has gone away */
+#define POLLNVAL	0x0020	/* fd is not an open file */
+
+#endif /* _KERN_POLL_H_ */
@@ -0,0 +1,33 @@
+#ifndef _KERN_SELECT_H_
+#define _KERN_SELECT_H_
+
+/*
+ * Definitions for select(): descriptor sets, one bit per possible
+ * file descriptor.
+ */
+
+#include <kern/limits.h>
+
+#define FD_SETSIZE	__OPEN_MAX
+
+/* bits per fds_bits word */
+#define __NFDBITS	32
+
+typedef struct {
+	__u32 fds_bits[(FD_SETSIZE + __NFDBITS - 1) / __NFDBITS];
+} fd_set;
+
+#define __FDWORD(fd)	((fd) / __NFDBITS)
+#define __FDMASK(fd)	((__u32)1 << ((fd) % __NFDBITS))
+
+#define FD_SET(fd, set)		((set)->fds_bits[__FDWORD(fd)] |= __FDMASK(fd))
+#define FD_CLR(fd, set)		((set)->fds_bits[__FDWORD(fd)] &= ~__FDMASK(fd))
+#define FD_ISSET(fd, set)	(((set)->fds_bits[__FDWORD(fd)] & __FDMASK(fd)) != 0)
+#define FD_ZERO(set) \
+	do { \
+		unsigned __i; \
+		for (__i = 0; __i < sizeof(fd_set) / sizeof(__u32); __i++) \
+			(set)->fds_bits[__i] = 0; \
+	} while (0)
+
+#endif /* _KERN_SELECT_H_ */
@@ -0,0 +1,92 @@
+#ifndef _PAGECACHE_H_
+#define _PAGECACHE_H_
+
+/*
+ * Per-vnode page cache.
+ *
+ * Each vnode can have a cache of pages vm_fault has read in from it,
+ * of two kinds. Text pages are the read-only pages of programs' text
+ * and read-only data, keyed by user address, which for a given
+ * executable is fixed by its program headers; the next process
+ * running the same executable maps the cached frame read-only
+ * instead of reading the page again, so fan-out workloads share one
+ * copy of their text. File pages are whole pages of the file, keyed
+ * by offset, as mapped by mmap: every MAP_SHARED mapping of the file
+ * maps the cached frame itself, which is what makes their writes
+ * visible to each other, and MAP_PRIVATE mappings map it
+ * copy-on-write.
+ *
+ * The cache holds a reference on each frame (frame_incref) but not
+ * on the vnode: it is emptied when the vnode is reclaimed, that is
+ * once nothing maps or has the file open. Writing the file with
+ * write() drops its text pages and the file pages nobody maps, and
+ * reads the written range into the file pages that are mapped, so
+ * mappings see the write and don't later write old data back over it.
+ *
+ * When memory runs short the pageout thread's clock hand also takes
+ * pages out of the cache (see swap.h): those nothing maps, and those
+ * only the process the frame is recorded against maps, once they
+ * are clean. Either way the next touch reads the page in again.
+ */
+
+struct vnode;
+
+/* kinds of cached page, by what their key is */
+#define PC_TEXT		0	/* user address in an executable */
+#define PC_FILE		1	/* page-aligned file offset */
+
+/*
+ * The frame caching VN's page of kind KIND at KEY, with a reference
+ * taken for the caller, or 0 if there is none.
+ */
+paddr_t pagecache_get(struct vnode *vn, int kind, off_t key);
+
+/*
+ * Offer frame PA, which the caller has read in, as VN's page of kind
+ * KIND at KEY. Returns the frame the caller should map: PA, now with
+ * an extra reference held by the cache, or, if another process got
+ * there first, the frame it cached, with a reference taken for the
+ * caller, who then frees PA.
+ */
+paddr_t pagecache_add(struct vnode *vn, int kind, off_t key, paddr_t pa);
+
+/*
+ * Drop VN's cached pages: with ALL, every one; otherwise those that
+ * are out of date once the file has been written, as above.
+ */
+void pagecache_purge(struct vnode *vn, bool all);
+
+/*
+ * VN has been written from byte START up to END: read that range
+ * into VN's cached file pages, as above.
+ */
+void pagecache_update(struct vnode *vn, off_t start, off_t end);
+
+/* Set up the cache's per-frame index; called by vm_bootstrap. */
+void pagecache_bootstrap(void);
+
+/*
+ * Whether frame PA holds a cached page. Not locked, so only a hint,
+ * except that with vm_lock held nothing can be added meanwhile.
+ */
+bool pagecache_holds(paddr_t pa);
+
+/*
+ * If frame PA holds a cached page and has REFS references, counting
+ * the cache's own, drop the page from the cache and the cache's
+ * reference to the frame. Returns whether it did.
+ */
+bool pagecache_evict(paddr_t pa, unsigned refs);
+
+/*
+ * The file whose page frame PA caches, with a reference taken for
+ * the caller, and the page's offset in *OFF; or NULL if PA holds no
+ * file page. The caller must know something else holds a reference
+ * to the file meanwhile, such as a mapping of PA.
+ */
+struct vnode *pagecache_file(paddr_t pa, off_t *off);
+
+/* Format the cache counters as text, like sysstats_format. */
+size_t pagecache_stats_format(char *buf, size_t len);
+
+#endif /* _PAGECACHE_H_ */
@@ -0,0 +1,95 @@
+#ifndef _PAGETABLE_H_
+#define _PAGETABLE_H_
+
+/*
+ * Two-level page tables for user address spaces.
+ *
+ * The top 10 bits of a virtual address index the top level, an
+ * array of pointers to second-level tables; the next 10 bits index
+ * the second-level table, which is one page of PT_L2_SIZE entries.
+ * A second-level table is only allocated once something in the 4M
+ * of address space it covers is touched, so a sparse address space
+ * costs little.
+ *
+ * An entry has the layout of a MIPS TLB EntryLo word so that it can
+ * be loaded into the TLB as is: the physical frame in PTE_FRAME,
+ * PTE_VALID once the page is resident, and PTE_WRITE if it may be
+ * written. An all-zero entry is a page that has never been touched.
+ *
+ * The low bits of EntryLo are ignored by the hardware and hold
+ * software state. PTE_COW marks a page that fork left shared
+ * read-only between parent and child although its region is
+ * writable; the first write to it faults and gets the writer its own
+ * copy (see vm_fault). PTE_SHARED marks a page of a MAP_SHARED file
+ * mapping, whose writes must reach every process mapping it; it is
+ * mapped read-only until first written, so that PTE_WRITE doubles as
+ * its dirty bit (see vm_syncpages). The others belong to the swap
+ * code (swap.h): a PTE_SWAP entry is not resident and holds a swap
+ * slot number in place of the frame, PTE_BUSY marks a page on its way
+ * to or from the swap disk, and PTE_IDLE a resident page taken out of
+ * the TLB to see whether it is still being used.
+ */
+
+#include <vm.h>
+#include <platform/maxcpus.h>
+
+typedef uint32_t pte_t;
+
+#define PTE_FRAME	0xfffff000	/* physical frame */
+#define PTE_WRITE	0x00000400	/* writable (TLBLO_DIRTY) */
+#define PTE_VALID	0x00000200	/* resident (TLBLO_VALID) */
+#define PTE_COW		0x00000001	/* shared, copy on first write */
+#define PTE_SWAP	0x00000002	/* swapped out; PTE_FRAME is the slot */
+#define PTE_BUSY	0x00000004	/* in transit to or from swap */
+#define PTE_IDLE	0x00000008	/* resident but not valid; see swap.h */
+#define PTE_SHARED	0x00000010	/* shared file mapping; never COW */
+
+#define PT_L1_SHIFT	22
+#define PT_L1_SIZE	(USERSPACETOP >> PT_L1_SHIFT)
+#define PT_L2_SIZE	(PAGE_SIZE / sizeof(pte_t))
+
+#define PT_L1_INDEX(va)	((va) >> PT_L1_SHIFT)
+#define PT_L2_INDEX(va)	(((va) >> 12) & (PT_L2_SIZE - 1))
+
+struct addrspace;
+
+struct pagetable {
+	pte_t *pt_l2[PT_L1_SIZE];
+	struct addrspace *pt_as;	/* owner, for the swap code */
+};
+
+/*
+ * The page table each CPU's fast TLB refill handler (utlb_refill in
+ * exception-mips1.S) walks, indexed by CPU number, or NULL to send
+ * every miss to vm_fault; and the count of misses it has refilled.
+ * Set through vm_tlbactivate.
+ */
+extern struct pagetable *cpupagetables[MAXCPUS];
+extern uint32_t cputlbrefills[MAXCPUS];
+
+/* Create an empty page table for AS. */
+struct pagetable *pt_create(struct addrspace *as);
+
+/*
+ * Destroy a page table, freeing every resident page and swap slot
+ * it holds. No page may be in transit (see swap_wait).
+ */
+void pt_destroy(struct pagetable *pt);
+
+/*
+ * Return the entry for user address VA. If its second-level table
+ * does not exist yet it is allocated when CREATE is set; otherwise,
+ * or if that allocation fails, NULL is returned.
+ */
+pte_t *pt_lookup(struct pagetable *pt, vaddr_t va, bool create);
+
+/*
+ * Map every page of OLD into NEW as well. The frames are shared, not
+ * copied: writable pages other than PTE_SHARED ones become
+ * copy-on-write in both tables, so the caller must flush OLD's stale
+ * writable TLB entries. Swapped-out
+ * pages are read back in first. Call with vm_lock held.
+ */
+int pt_copy(struct pagetable *old, struct pagetable *new);
+
+#endif /* _PAGETABLE_H_ */
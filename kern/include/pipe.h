@@ -0,0 +1,17 @@
+#ifndef _PIPE_H_
+#define _PIPE_H_
+
+/*
+ * Anonymous pipes.
+ *
+ * pipe_create makes a pipe and returns a vnode for each end, each
+ * holding one reference. Data written to WRITEVN can be read from
+ * READVN. Once every reference to one end is gone, reads from the
+ * other end see end of file or writes fail with EPIPE.
+ */
+
+struct vnode;
+
+int pipe_create(struct vnode **readvn, struct vnode **writevn);
+
+#endif /* _PIPE_H_ */
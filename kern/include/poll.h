@@ -0,0 +1,24 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+/*
+ * Kernel side of poll() and select().
+ *
+ * Readiness is reported by VOP_POLL. Nothing keeps track of who is
+ * polling what: a poller that finds nothing ready sleeps on one
+ * shared wait channel, and anything whose readiness might have
+ * changed calls poll_wakeup() to wake every poller so they look
+ * again. Callers of poll_wakeup() should call it when a condition
+ * becomes true (data arriving, space freeing up), not on every
+ * state change. It is safe in interrupt handlers.
+ */
+
+#include <kern/poll.h>
+
+void poll_bootstrap(void);
+void poll_wakeup(void);
+
+/* called from hardclock() so pollers with timeouts get to look */
+void poll_hardclock(void);
+
+#endif /* _POLL_H_ */
@@ -62,17 +62,30 @@ struct vnode;
  */
 struct proc {
 	char *p_name;			/* Name of this process */
+	pid_t p_pid;			/* Process id */
 	struct spinlock p_lock;		/* Lock for this structure */
 	unsigned p_numthreads;		/* Number of threads in this process */
 
 	/* VM */
 	struct addrspace *p_addrspace;	/* virtual address space */
+	uint32_t p_minflt;		/* page faults served from memory */
+	uint32_t p_majflt;		/* and from disk; see getrusage */
+	uint32_t p_prefault;		/* pages mapped by fault-around */
 
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
 
+	/* exit and wait; protected by the lock in proc.c */
+	struct proc *p_parent;		/* NULL if none, or once it exits */
+	struct proc *p_next;		/* on the list of user processes */
+	bool p_exited;			/* called _exit, not yet waited for */
+	int p_exitstatus;		/* as waitpid reports it */
+
 	/* add more material here as needed */
 	int fd_table[OPEN_MAX];		/* file descriptor table */
+	uint32_t fd_bitmap[FD_BITMAP_WORDS];	/* set bit = fd in use */
+	userptr_t p_ioring;		/* registered submission ring, or NULL */
+	unsigned p_ioring_entries;	/* slots in p_ioring */
 };
 
 /* This is the process structure for the kernel and for kernel-only threads. */
@@ -84,9 +97,18 @@ void proc_bootstrap(void);
 /* Create a fresh process for use by runprogram(). */
 struct proc *proc_create_runprogram(const char *name);
 
+/* Create a copy-on-write child of the current process for fork(). */
+int proc_fork(struct proc **ret);
+
 /* Destroy a process. */
 void proc_destroy(struct proc *proc);
 
+/* Exit the current process with STATUS, as encoded for waitpid. */
+__DEAD void proc_exit(int status);
+
+/* Wait for the child PID of the current process to exit. */
+int proc_wait(pid_t pid, int options, pid_t *retpid, int *status);
+
 /* Attach a thread to a process. Must not already have a process. */
 int proc_addthread(struct proc *proc, struct thread *t);
 
@@ -0,0 +1,95 @@
+#ifndef _SWAP_H_
+#define _SWAP_H_
+
+/*
+ * Paging user pages out to a swap disk.
+ *
+ * The swap disk is the raw second hard disk, lhd1raw:, split into
+ * page-sized slots that are handed out from a bitmap. If it is not
+ * there, no anonymous page is ever paged out, and only the page
+ * cache below can give frames back.
+ *
+ * Every frame holding a user page records the address space and
+ * address it backs, so that a clock hand can sweep the frames: a
+ * page found in use has its entry made PTE_IDLE, which takes it out
+ * of the TLB, and a page still idle when the hand comes round again
+ * is paged out. Frames shared copy-on-write are never chosen.
+ *
+ * Page cache frames (pagecache.h) record the last process to map
+ * them. The hand drops one from the cache as soon as it finds
+ * nothing mapping it, and treats one that only its recorded mapping
+ * maps like any other page, except that going out means just being
+ * unmapped, as the file still has it. A dirty page of a shared
+ * mapping is written back to the file first, and goes on a later
+ * round if it has stayed clean and idle. Cached frames mapped by
+ * more than one process stay put, as does one whose recorded mapping
+ * has gone while others remain, until they are unmapped too.
+ *
+ * Page-outs are done by a pageout thread, a batch at a time: the
+ * victims are unmapped and copied into one buffer, their frames are
+ * freed straight away, and the buffer is written to contiguous slots
+ * with the VM lock dropped. Their entries stay PTE_BUSY until the
+ * write is done. Dirty shared pages are written back to their files
+ * in the same unlocked stretch. The thread runs when an allocation finds no free
+ * frame, and also whenever free frames run low, so that most page
+ * faults find one without waiting.
+ *
+ * Everything here is called with vm_lock held, and may drop it while
+ * waiting for I/O or for frames.
+ */
+
+#include <pagetable.h>
+
+struct addrspace;
+struct lock;
+
+/*
+ * Serializes page faults, eviction, and copying and destroying
+ * address spaces, so the clock hand can follow a frame to its page
+ * table entry.
+ */
+extern struct lock *vm_lock;
+
+/* Open the swap disk, if any, and start the pageout thread. */
+void swap_bootstrap(void);
+
+/*
+ * A frame for a user page, zero-filled if ZERO is set. Pages other
+ * frames out if there are none free; returns 0 if none could be had.
+ */
+paddr_t swap_allocframe(bool zero);
+
+/*
+ * Like swap_allocframe, but only while frames are plentiful: returns
+ * 0 rather than page anything out or dig into the frames the pageout
+ * thread keeps free.
+ */
+paddr_t swap_tryframe(bool zero);
+
+/*
+ * Record the user page a frame backs, making it a candidate for
+ * eviction, or with AS NULL forget it. A page cache frame records
+ * whichever mapping of it was made last.
+ */
+void swap_setowner(paddr_t pa, struct addrspace *as, vaddr_t va);
+
+/* Drop AS's reference to a user page frame. */
+void swap_freeframe(paddr_t pa, struct addrspace *as);
+
+/*
+ * Read the swapped-out page at VA, whose entry is PTE, back into
+ * a new frame and make the entry valid. Waits first if the page is
+ * still being written out.
+ */
+int swap_pagein(struct addrspace *as, vaddr_t va, pte_t *pte);
+
+/* Give back the swap slot of a swapped-out entry. */
+void swap_freeslot(pte_t pte);
+
+/* Wait until no page of AS is on its way to or from the swap disk. */
+void swap_wait(struct addrspace *as);
+
+/* Format the paging counters as text, like sysstats_format. */
+size_t swap_stats_format(char *buf, size_t len);
+
+#endif /* _SWAP_H_ */
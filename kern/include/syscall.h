@@ -58,5 +58,21 @@ __DEAD void enter_new_process(int argc, userptr_t argv, userptr_t env,
 
 int sys_reboot(int code);
 int sys___time(userptr_t user_seconds, userptr_t user_nanoseconds);
+int sys_fork(struct trapframe *tf, int32_t *retval);
+__DEAD void sys__exit(int code);
+int sys_waitpid(pid_t pid, userptr_t status, int options, int32_t *retval);
+int sys_sbrk(intptr_t amount, int32_t *retval);
+int sys_mmap(vaddr_t addr, size_t len, int prot, int flags, int fd,
+	     off_t offset, int32_t *retval);
+int sys_munmap(vaddr_t addr, size_t len);
+int sys_msync(vaddr_t addr, size_t len, int flags);
+int sys_getrusage(int who, userptr_t usage);
+int sys_getrlimit(int resource, userptr_t rlp);
+int sys_setrlimit(int resource, const_userptr_t rlp);
+int sys_ioring_setup(userptr_t ring, unsigned entries);
+int sys_ioring_enter(unsigned to_submit, int32_t *retval);
+int sys_poll(userptr_t fds, unsigned nfds, int timeout_ms, int32_t *retval);
+int sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	       userptr_t exceptfds, userptr_t timeout, int32_t *retval);
 
 #endif /* _SYSCALL_H_ */
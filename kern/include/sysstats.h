@@ -0,0 +1,54 @@
+#ifndef _SYSSTATS_H_
+#define _SYSSTATS_H_
+
+/*
+ * Per-syscall counters and latency histograms.
+ *
+ * Each cpu has its own struct sysstats, hung off struct cpu, which
+ * only that cpu ever writes; readers add up all the cpus. Latency
+ * bucket b counts calls that took [2^b, 2^(b+1)) microseconds, with
+ * bucket 0 also taking anything quicker and the last bucket anything
+ * slower.
+ */
+
+#include <kern/time.h>
+
+#define SYSSTATS_NCALLS		128	/* callnos 0 .. NCALLS-1 are tracked */
+#define SYSSTATS_NBUCKETS	20	/* 1us .. 512ms and up */
+
+struct sysstats_call {
+	uint32_t sc_count;			/* calls made */
+	uint32_t sc_errors;			/* calls that failed */
+	uint32_t sc_hist[SYSSTATS_NBUCKETS];	/* latency histogram */
+};
+
+struct sysstats {
+	struct sysstats_call ss_calls[SYSSTATS_NCALLS];
+};
+
+/* allocate zeroed stats for a new cpu; NULL if out of memory */
+struct sysstats *sysstats_create(void);
+
+/* account for one syscall that started at START and returned ERR */
+void sysstats_record(int callno, const struct timespec *start, int err);
+
+/*
+ * Format the summed stats as text into BUF, which has room for LEN
+ * bytes. The length of the whole text is returned, even if it was
+ * cut short.
+ */
+size_t sysstats_format(char *buf, size_t len);
+
+/*
+ * Like snprintf, but appending at POS and advancing it, and still
+ * counting once BUF's LEN bytes are full; for this and the other
+ * *_format functions.
+ */
+#define SYSSTATS_PRINTF(buf, len, pos, ...) \
+	((pos) += snprintf((pos) < (len) ? (buf) + (pos) : NULL, \
+			   (pos) < (len) ? (len) - (pos) : 0, __VA_ARGS__))
+
+/* print the summed stats on the console */
+void sysstats_print(void);
+
+#endif /* _SYSSTATS_H_ */
@@ -140,4 +140,12 @@ void uio_kinit(struct iovec *, struct uio *,
 
 void uio_uinit(struct iovec *iov, struct uio *u, userptr_t buf,
 	size_t len, off_t offset, enum uio_rw rw);
+
+/*
+ * Initialize a uio over IOVCNT user iovecs (readv/writev). The iovec
+ * array itself must be in kernel memory; the buffers it points to
+ * are user pointers.
+ */
+void uio_uinitv(struct iovec *iov, unsigned iovcnt, struct uio *u,
+	off_t offset, enum uio_rw rw);
 #endif /* _UIO_H_ */
@@ -39,6 +39,16 @@
 
 #include <machine/vm.h>
 
+/*
+ * Fault-around window, in pages: a page fault that touches a page
+ * for the first time also maps the untouched pages around it, in the
+ * aligned window of this many pages, that need no I/O. A power of
+ * two no more than VM_FAULTAROUND_MAX; 1 turns it off. Set from the
+ * kernel menu with "fa".
+ */
+#define VM_FAULTAROUND_MAX   64
+extern unsigned vm_faultaround;
+
 /* Fault-type arguments to vm_fault() */
 #define VM_FAULT_READ        0    /* A read was attempted */
 #define VM_FAULT_WRITE       1    /* A write was attempted */
@@ -55,8 +65,81 @@ int vm_fault(int faulttype, vaddr_t faultaddress);
 vaddr_t alloc_kpages(unsigned npages);
 void free_kpages(vaddr_t addr);
 
+/*
+ * Frame reference counts (unsw allocator only). alloc_kpages hands
+ * out a block holding one reference; free_kpages drops one and only
+ * frees the block when none are left. frame_incref adds one so the
+ * frame can be shared.
+ */
+void frame_incref(paddr_t paddr);
+unsigned frame_refcount(paddr_t paddr);
+
+/* Roughly how many frames are free right now. */
+unsigned frame_nfree(void);
+
+/*
+ * Return the free frames cached per CPU, and the zero pool, to the
+ * shared free lists, e.g. when memory is short.
+ */
+void frame_drain(void);
+
+/*
+ * Zero-filled pages. alloc_zeroed_kpage is alloc_kpages(1) plus
+ * bzero, but takes a page zeroed in advance by frame_zero_idle, which
+ * idle CPUs call, when there is one.
+ */
+vaddr_t alloc_zeroed_kpage(void);
+bool frame_zero_idle(void);
+
+/*
+ * Free block counts per buddy order, and the largest free block,
+ * as text (like sysstats_format) or on the console.
+ */
+size_t frame_stats_format(char *buf, size_t len);
+void frame_printstats(void);
+
 /* TLB shootdown handling called from interprocessor_interrupt */
 void vm_tlbshootdown(const struct tlbshootdown *);
 
+/* Invalidate every entry in this CPU's TLB. */
+void vm_tlbflush(void);
+
+/*
+ * Make AS (NULL for none) the address space this CPU's TLB maps,
+ * giving it an address space ID here if it has no current one.
+ */
+struct addrspace;
+void vm_tlbactivate(struct addrspace *as);
+
+/* Drop every TLB entry of AS, on all CPUs, by retiring its IDs. */
+void vm_tlbflush_as(struct addrspace *as);
+
+/*
+ * Write the file page in frame PA back to VN at offset OFF, as far
+ * as the end of the file, which it never extends.
+ */
+struct vnode;
+int vm_writefilepage(struct vnode *vn, off_t off, paddr_t pa);
+
+/*
+ * Write the pages of region REG of AS in [START, END) that have been
+ * written since they were mapped or last synced back to the file, if
+ * it is a shared mapping. With UNMAP, also throw out every page in
+ * the range, written back or not, which is all it does for any other
+ * kind of region.
+ */
+struct region;
+int vm_syncpages(struct addrspace *as, struct region *reg, vaddr_t start,
+		 vaddr_t end, bool unmap);
+
+/*
+ * Drop AS's TLB entry for the page at VADDR on every CPU, waiting
+ * for the other CPUs to do it. Call with vm_lock held.
+ */
+void vm_tlbinval(struct addrspace *as, vaddr_t vaddr);
+
+/* Format the per-CPU TLB miss counters as text, like sysstats_format. */
+size_t vm_tlbstats_format(char *buf, size_t len);
+
 
 #endif /* _VM_H_ */
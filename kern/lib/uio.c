@@ -176,3 +176,25 @@ void uio_uinit(struct iovec *iov, struct uio *u, userptr_t buf,
 	u->uio_rw = rw;
 	u->uio_space = proc_getas();
 }
+
+/*
+ * Initialize a uio over an array of user iovecs already copied into
+ * the kernel, for readv/writev. The caller checks that the lengths
+ * do not overflow.
+ */
+void uio_uinitv(struct iovec *iov, unsigned iovcnt, struct uio *u,
+	off_t offset, enum uio_rw rw)
+{
+	unsigned i;
+
+	u->uio_iov = iov;
+	u->uio_iovcnt = iovcnt;
+	u->uio_offset = offset;
+	u->uio_resid = 0;
+	for (i = 0; i < iovcnt; i++) {
+		u->uio_resid += iov[i].iov_len;
+	}
+	u->uio_segflg = UIO_USERSPACE;
+	u->uio_rw = rw;
+	u->uio_space = proc_getas();
+}
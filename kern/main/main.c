@@ -38,6 +38,7 @@
 #include <lib.h>
 #include <spl.h>
 #include <clock.h>
+#include <poll.h>
 #include <thread.h>
 #include <proc.h>
 #include <current.h>
@@ -111,6 +112,7 @@ boot(void)
 	proc_bootstrap();
 	thread_bootstrap();
 	hardclock_bootstrap();
+	poll_bootstrap();
 	vfs_bootstrap();
 	kheap_nextgeneration();
 
@@ -43,8 +43,12 @@
 #include <sfs.h>
 #include <syscall.h>
 #include <test.h>
+#include <sysstats.h>
+#include <vm.h>
 #include "opt-sfs.h"
 #include "opt-net.h"
+#include "opt-unsw.h"
+#include "opt-dumbvm.h"
 
 /*
  * In-kernel menu and command dispatcher.
@@ -134,8 +138,8 @@ common_prog(int nargs, char **args)
 	}
 
 	/*
-	 * The new process will be destroyed when the program exits...
-	 * once you write the code for handling that.
+	 * The new process will be destroyed when the program exits;
+	 * it has no parent to wait for it. See proc_exit.
 	 */
 
 	return 0;
@@ -494,6 +498,63 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+#if OPT_UNSW
+static
+int
+cmd_framestats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	frame_printstats();
+
+	return 0;
+}
+#endif
+
+#if !OPT_DUMBVM
+/*
+ * Command to show or set the fault-around window.
+ */
+static
+int
+cmd_faultaround(int nargs, char **args)
+{
+	unsigned pages;
+
+	if (nargs == 1) {
+		kprintf("Fault-around window: %u pages\n", vm_faultaround);
+		return 0;
+	}
+	if (nargs != 2) {
+		kprintf("Usage: fa [pages]\n");
+		return EINVAL;
+	}
+
+	pages = atoi(args[1]);
+	if (pages == 0 || pages > VM_FAULTAROUND_MAX ||
+	    (pages & (pages - 1)) != 0) {
+		kprintf("fa: window must be a power of two from 1 to %u\n",
+			VM_FAULTAROUND_MAX);
+		return EINVAL;
+	}
+	vm_faultaround = pages;
+	return 0;
+}
+#endif
+
+static
+int
+cmd_sysstats(int nargs, char **args)
+{
+	(void)nargs;
+	(void)args;
+
+	sysstats_print();
+
+	return 0;
+}
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -533,6 +594,10 @@ static const char *opsmenu[] = {
 	"[cd]      Change directory          ",
 	"[pwd]     Print current directory   ",
 	"[sync]    Sync filesystems          ",
+	"[ss]      Syscall statistics        ",
+#if !OPT_DUMBVM
+	"[fa]      Fault-around window       ",
+#endif
 	"[debug]   Drop to debugger          ",
 	"[panic]   Intentional panic         ",
 	"[deadlock] Intentional deadlock     ",
@@ -599,6 +664,9 @@ static const char *mainmenu[] = {
 	"[kh] Kernel heap stats              ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+#if OPT_UNSW
+	"[fr] Frame allocator stats          ",
+#endif
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -650,6 +718,13 @@ static struct {
 	{ "kh",         cmd_kheapstats },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "ss",		cmd_sysstats },
+#if !OPT_DUMBVM
+	{ "fa",		cmd_faultaround },
+#endif
+#if OPT_UNSW
+	{ "fr",		cmd_framestats },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -43,7 +43,12 @@
  */
 
 #include <types.h>
+#include <kern/errno.h>
+#include <kern/wait.h>
+#include <limits.h>
 #include <spl.h>
+#include <synch.h>
+#include <thread.h>
 #include <proc.h>
 #include <current.h>
 #include <addrspace.h>
@@ -54,6 +59,18 @@
  */
 struct proc *kproc;
 
+/*
+ * User processes, from creation until they have exited and been
+ * waited for (or orphaned), are kept on proc_list. Process ids are
+ * handed out in sequence, wrapping at PID_MAX and skipping any still
+ * on the list. proc_lock protects the list, the ids, and the wait/exit
+ * fields of every process on it; proc_cv is signalled on each exit.
+ */
+static struct lock *proc_lock;
+static struct cv *proc_cv;
+static struct proc *proc_list;
+static pid_t pid_next = PID_MIN;
+
 /*
  * Create a proc structure.
  */
@@ -62,6 +79,7 @@ struct proc *
 proc_create(const char *name)
 {
 	struct proc *proc;
+	unsigned i;
 
 	proc = kmalloc(sizeof(*proc));
 	if (proc == NULL) {
@@ -73,23 +91,100 @@ proc_create(const char *name)
 		return NULL;
 	}
 
+	proc->p_pid = 0;
 	proc->p_numthreads = 0;
 	spinlock_init(&proc->p_lock);
 
 	/* VM fields */
 	proc->p_addrspace = NULL;
+	proc->p_minflt = 0;
+	proc->p_majflt = 0;
+	proc->p_prefault = 0;
 
 	/* VFS fields */
 	proc->p_cwd = NULL;
 
+	/* wait/exit fields, see proc_link */
+	proc->p_parent = NULL;
+	proc->p_next = NULL;
+	proc->p_exited = false;
+	proc->p_exitstatus = 0;
+
+	/* no descriptors until fd_table_init or fd_table_copy */
+	for (i=0; i<OPEN_MAX; i++) {
+		proc->fd_table[i] = FILE_CLOSED;
+	}
+	for (i=0; i<FD_BITMAP_WORDS; i++) {
+		proc->fd_bitmap[i] = 0;
+	}
+
+	/* batched I/O ring, see ioring_setup() */
+	proc->p_ioring = NULL;
+	proc->p_ioring_entries = 0;
+
 	return proc;
 }
 
 /*
- * Destroy a proc structure.
- *
- * Note: nothing currently calls this. Your wait/exit code will
- * probably want to do so.
+ * Give a new user process an id and put it on proc_list, as a child
+ * of PARENT if that is not NULL.
+ */
+static
+int
+proc_link(struct proc *proc, struct proc *parent)
+{
+	struct proc *p;
+	pid_t pid, first;
+
+	lock_acquire(proc_lock);
+	first = pid = pid_next;
+	for (p = proc_list; p != NULL; ) {
+		if (p->p_pid != pid) {
+			p = p->p_next;
+			continue;
+		}
+		/* in use; try the next one, from the top */
+		pid = pid == PID_MAX ? PID_MIN : pid + 1;
+		if (pid == first) {
+			lock_release(proc_lock);
+			return ENPROC;
+		}
+		p = proc_list;
+	}
+	pid_next = pid == PID_MAX ? PID_MIN : pid + 1;
+
+	proc->p_pid = pid;
+	proc->p_parent = parent;
+	proc->p_next = proc_list;
+	proc_list = proc;
+	lock_release(proc_lock);
+	return 0;
+}
+
+/*
+ * Take PROC off proc_list, if it is there. Call with proc_lock held.
+ */
+static
+void
+proc_unlink(struct proc *proc)
+{
+	struct proc **pp;
+
+	KASSERT(lock_do_i_hold(proc_lock));
+
+	for (pp = &proc_list; *pp != NULL; pp = &(*pp)->p_next) {
+		if (*pp == proc) {
+			*pp = proc->p_next;
+			proc->p_next = NULL;
+			return;
+		}
+	}
+}
+
+/*
+ * Destroy a proc structure. Called by waitpid for an exited child,
+ * by _exit for exited children nobody is left to wait for, and when
+ * fork or runprogram fail.
  */
 void
 proc_destroy(struct proc *proc)
@@ -105,6 +200,10 @@ proc_destroy(struct proc *proc)
 	KASSERT(proc != NULL);
 	KASSERT(proc != kproc);
 
+	lock_acquire(proc_lock);
+	proc_unlink(proc);
+	lock_release(proc_lock);
+
 	/*
 	 * We don't take p_lock in here because we must have the only
 	 * reference to this structure. (Otherwise it would be
@@ -112,6 +211,7 @@ proc_destroy(struct proc *proc)
 	 */
 
 	/* VFS fields */
+	fd_table_destroy(proc);
 	if (proc->p_cwd) {
 		VOP_DECREF(proc->p_cwd);
 		proc->p_cwd = NULL;
@@ -182,6 +282,11 @@ proc_bootstrap(void)
 	if (kproc == NULL) {
 		panic("proc_create for kproc failed\n");
 	}
+	proc_lock = lock_create("proc");
+	proc_cv = cv_create("proc");
+	if (proc_lock == NULL || proc_cv == NULL) {
+		panic("proc_bootstrap: out of memory\n");
+	}
 }
 
 /*
@@ -199,6 +304,11 @@ proc_create_runprogram(const char *name)
 	if (newproc == NULL) {
 		return NULL;
 	}
+	/* nobody waits for it: the menu doesn't */
+	if (proc_link(newproc, NULL)) {
+		proc_destroy(newproc);
+		return NULL;
+	}
 
 	/* VM fields */
 
@@ -221,6 +331,181 @@ proc_create_runprogram(const char *name)
 	return newproc;
 }
 
+/*
+ * Create a child of the current process for fork.
+ *
+ * It gets a copy-on-write copy of the address space (see as_copy),
+ * shares all open files, and inherits the current directory and
+ * the registered I/O ring, which lives in the copied user memory.
+ */
+int
+proc_fork(struct proc **ret)
+{
+	struct proc *newproc;
+	struct addrspace *as;
+	int result;
+
+	newproc = proc_create(curproc->p_name);
+	if (newproc == NULL) {
+		return ENOMEM;
+	}
+	result = proc_link(newproc, curproc);
+	if (result) {
+		proc_destroy(newproc);
+		return result;
+	}
+
+	/* VM fields */
+
+	as = proc_getas();
+	if (as != NULL) {
+		result = as_copy(as, &newproc->p_addrspace);
+		if (result) {
+			proc_destroy(newproc);
+			return result;
+		}
+	}
+
+	/* VFS fields */
+
+	fd_table_copy(newproc);
+
+	spinlock_acquire(&curproc->p_lock);
+	if (curproc->p_cwd != NULL) {
+		VOP_INCREF(curproc->p_cwd);
+		newproc->p_cwd = curproc->p_cwd;
+	}
+	spinlock_release(&curproc->p_lock);
+
+	newproc->p_ioring = curproc->p_ioring;
+	newproc->p_ioring_entries = curproc->p_ioring_entries;
+
+	*ret = newproc;
+	return 0;
+}
+
+/*
+ * Destroy, one at a time, processes that have exited and that nobody
+ * is left to wait for.
+ */
+static
+void
+proc_reap_orphans(void)
+{
+	struct proc *p;
+
+	while (1) {
+		lock_acquire(proc_lock);
+		for (p = proc_list; p != NULL; p = p->p_next) {
+			if (p->p_exited && p->p_parent == NULL) {
+				break;
+			}
+		}
+		if (p != NULL) {
+			/* off the list, so nobody else finds it */
+			proc_unlink(p);
+		}
+		lock_release(proc_lock);
+		if (p == NULL) {
+			return;
+		}
+		proc_destroy(p);
+	}
+}
+
+/*
+ * Exit the current process. What a zombie doesn't need (address
+ * space, files, current directory) goes now; the rest stays on
+ * proc_list holding STATUS until the parent waits for it. The thread
+ * finishes up in kproc, so that whoever destroys the process need not
+ * wait for it to get off the cpu.
+ */
+void
+proc_exit(int status)
+{
+	struct proc *proc = curproc;
+	struct addrspace *as;
+	struct proc *p;
+
+	KASSERT(proc != NULL);
+	KASSERT(proc != kproc);
+
+	fd_table_destroy(proc);
+	if (proc->p_cwd != NULL) {
+		VOP_DECREF(proc->p_cwd);
+		proc->p_cwd = NULL;
+	}
+
+	as = proc_setas(NULL);
+	as_deactivate();
+	if (as != NULL) {
+		as_destroy(as);
+	}
+
+	proc_remthread(curthread);
+	proc_addthread(kproc, curthread);
+
+	lock_acquire(proc_lock);
+	proc->p_exited = true;
+	proc->p_exitstatus = status;
+	for (p = proc_list; p != NULL; p = p->p_next) {
+		if (p->p_parent == proc) {
+			p->p_parent = NULL;
+		}
+	}
+	cv_broadcast(proc_cv, proc_lock);
+	lock_release(proc_lock);
+
+	/* our exited children, and us if nobody will wait */
+	proc_reap_orphans();
+	thread_exit();
+}
+
+/*
+ * Wait for the child PID of the current process to exit, then return
+ * its status and destroy it. With WNOHANG, return a pid of 0 instead
+ * of waiting.
+ */
+int
+proc_wait(pid_t pid, int options, pid_t *retpid, int *status)
+{
+	struct proc *p;
+
+	if ((options & ~WNOHANG) != 0) {
+		return EINVAL;
+	}
+
+	lock_acquire(proc_lock);
+	for (p = proc_list; p != NULL; p = p->p_next) {
+		if (p->p_pid == pid) {
+			break;
+		}
+	}
+	if (p == NULL) {
+		lock_release(proc_lock);
+		return ESRCH;
+	}
+	if (p->p_parent != curproc) {
+		lock_release(proc_lock);
+		return ECHILD;
+	}
+	while (!p->p_exited) {
+		if (options & WNOHANG) {
+			lock_release(proc_lock);
+			*retpid = 0;
+			return 0;
+		}
+		cv_wait(proc_cv, proc_lock);
+	}
+	*status = p->p_exitstatus;
+	proc_unlink(p);
+	lock_release(proc_lock);
+
+	proc_destroy(p);
+	*retpid = pid;
+	return 0;
+}
+
 /*
  * Add a thread to a process. Either the thread or the process might
  * or might not be current.
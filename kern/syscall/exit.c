@@ -0,0 +1,41 @@
+/*
+ * _exit() and waitpid(). A process that exits stays around, holding
+ * its exit status, until its parent waits for it or itself exits:
+ * see proc_exit and proc_wait.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/wait.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <proc.h>
+#include <syscall.h>
+
+void
+sys__exit(int code)
+{
+	proc_exit(_MKWAIT_EXIT(code));
+}
+
+int
+sys_waitpid(pid_t pid, userptr_t status, int options, int32_t *retval)
+{
+	pid_t ret;
+	int kstatus;
+	int err;
+
+	err = proc_wait(pid, options, &ret, &kstatus);
+	if (err) {
+		return err;
+	}
+	if (ret != 0 && status != NULL) {
+		err = copyout(&kstatus, status, sizeof(kstatus));
+		if (err) {
+			return err;
+		}
+	}
+
+	*retval = ret;
+	return 0;
+}
@@ -11,11 +11,22 @@
 #include <synch.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <pipe.h>
 #include <file.h>
 #include <syscall.h>
 #include <copyinout.h>
 #include <proc.h>
+#include <vm.h>
+#include <membar.h>
+#include <atomic.h>
+#include <pagecache.h>
+#include "opt-dumbvm.h"
 
+/* iovec arrays up to this size are copied in onto the kernel stack */
+#define FILE_FASTIOV 8
+
+/* kernel bounce buffer for copy_file_range; falls back to one page */
+#define FILE_COPYBUF (16 * PAGE_SIZE)
 
 static int std_init(void){
     int fd;
@@ -36,51 +47,225 @@ static int std_init(void){
 }
 
 
-int sys_open(char *filename, int flags, mode_t mode, int32_t *retval){
-    struct vnode *vn;
+/*
+ * Per-process descriptor bitmap. Bit fd of fd_bitmap is set while fd
+ * is in use, so the lowest free descriptor is found a word at a time
+ * instead of scanning fd_table. Only the owning process touches its
+ * own bitmap, so no lock is needed.
+ */
+
+/* index of the lowest clear bit in word, which must not be all ones */
+static unsigned fd_ffz(uint32_t word){
+    static const unsigned char debruijn[32] = {
+        0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+        31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+    };
+    /* isolate the lowest zero bit, then look up its position */
+    uint32_t low = ~word & (word + 1);
+    return debruijn[(uint32_t)(low * 0x077cb531U) >> 27];
+}
+
+static int fd_alloc(int *ret){
+    uint32_t *map = curproc->fd_bitmap;
+
+    for(unsigned i = 0; i < FD_BITMAP_WORDS; i++){
+        if(map[i] == 0xffffffff){
+            continue;
+        }
+        unsigned fd = i * 32 + fd_ffz(map[i]);
+        if(fd >= OPEN_MAX){
+            break;
+        }
+        map[i] |= (uint32_t)1 << (fd % 32);
+        *ret = fd;
+        return 0;
+    }
+    return EMFILE;
+}
+
+static void fd_mark(int fd){
+    curproc->fd_bitmap[fd / 32] |= (uint32_t)1 << (fd % 32);
+}
+
+static void fd_unmark(int fd){
+    curproc->fd_bitmap[fd / 32] &= ~((uint32_t)1 << (fd % 32));
+}
+
+static struct open_file *open_file_at(int of_index){
+    unsigned slab;
+
+    KASSERT(of_index >= 0 &&
+        (unsigned)of_index < of_table->nslabs * OFT_SLAB_FILES);
+    slab = of_index / OFT_SLAB_FILES;
+    return &of_table->dirs[slab / OFT_DIR_SLABS][slab % OFT_DIR_SLABS]
+        [of_index % OFT_SLAB_FILES];
+}
+
+/* add one slab of free entries to the open file table */
+static int oft_grow(void){
+    struct open_file **dir;
+    struct open_file *slab;
+    unsigned base;
+    int i;
+
+    KASSERT(lock_do_i_hold(of_table->oft_lock));
+
+    if(of_table->nslabs == OFT_MAX_DIRS * OFT_DIR_SLABS){
+        return ENFILE;
+    }
+
+    /* the first slab of a directory brings the directory */
+    dir = of_table->dirs[of_table->nslabs / OFT_DIR_SLABS];
+    if(dir == NULL){
+        dir = kmalloc(OFT_DIR_SLABS * sizeof(struct open_file *));
+        if(dir == NULL){
+            return ENOMEM;
+        }
+        of_table->dirs[of_table->nslabs / OFT_DIR_SLABS] = dir;
+    }
+
+    slab = kmalloc(OFT_SLAB_FILES * sizeof(struct open_file));
+    if(slab == NULL){
+        return ENOMEM;
+    }
+    base = of_table->nslabs * OFT_SLAB_FILES;
+
+    /* push in reverse so the lowest slot is handed out first */
+    for(i = OFT_SLAB_FILES - 1; i >= 0; i--){
+        slab[i].vnode = NULL;
+        slab[i].refcount = 0;
+        slab[i].of_lock = NULL;
+        slab[i].of_index = base + i;
+        slab[i].of_next = of_table->freelist;
+        of_table->freelist = &slab[i];
+    }
+
+    /* the slab must be visible before anything can index into it */
+    dir[of_table->nslabs % OFT_DIR_SLABS] = slab;
+    membar_store_store();
+    of_table->nslabs++;
+    return 0;
+}
+
+/* take a free entry off the open file table's free list */
+static int oft_alloc(struct open_file **ret){
+    struct open_file *open_file;
     int err;
 
-    err = vfs_open(filename, flags, mode, &vn);
-    if(err){
-        return err;
+    KASSERT(lock_do_i_hold(of_table->oft_lock));
+
+    if(of_table->freelist == NULL){
+        err = oft_grow();
+        if(err){
+            return err;
+        }
+    }
+    open_file = of_table->freelist;
+
+    /* entries keep their lock across reuse; create it on first use */
+    if(open_file->of_lock == NULL){
+        open_file->of_lock = lock_create("of_lock");
+        if(open_file->of_lock == NULL){
+            return ENOMEM;
+        }
+    }
+    of_table->freelist = open_file->of_next;
+    open_file->of_next = NULL;
+
+    *ret = open_file;
+    return 0;
+}
+
+/*
+ * Drop a reference. The last one puts the entry back on the free
+ * list, which is the only time oft_lock is needed, and then closes
+ * the vnode with no lock held.
+ */
+static void open_file_put(struct open_file *open_file){
+    struct vnode *vn;
+
+    KASSERT(open_file->refcount > 0);
+
+    if(atomic_add(&open_file->refcount, -1) > 0){
+        return;
     }
 
-    // get current fd table
-    int *fd_table = curproc->fd_table;
+    /* nobody can get at the entry now until it is reallocated */
+    vn = open_file->vnode;
+    open_file->vnode = NULL;
 
-    // lock open file table for current proc
     lock_acquire(of_table->oft_lock);
-    int fd_temp = -1;
-    int of_index = -1;
+    open_file->of_next = of_table->freelist;
+    of_table->freelist = open_file;
+    lock_release(of_table->oft_lock);
 
-    // find available spot in file descerptor in cur process fdt 
-    for(int i = 0; i < OPEN_MAX; i++){
-        if(fd_table[i] == FILE_CLOSED){
-            fd_temp = i;
-            break;
+    vfs_close(vn);
+}
+
+/*
+ * Look up the open file behind fd and take a reference on it, so
+ * the entry stays valid while it is used. Pair with open_file_put().
+ *
+ * No lock is taken: slabs are never freed, so the entry can always
+ * be dereferenced, and the reference is only taken if the count is
+ * still nonzero, i.e. the entry has not gone back on the free list.
+ * If fd was closed or reused meanwhile, drop it and look again.
+ */
+static int open_file_get(int fd, struct open_file **ret){
+    struct open_file *open_file;
+    int of_index;
+
+    if(fd < 0 || fd >= OPEN_MAX)
+        return EBADF;
+
+    while(1){
+        of_index = curproc->fd_table[fd];
+        if(of_index == FILE_CLOSED){
+            return EBADF;
+        }
+        open_file = open_file_at(of_index);
+        if(atomic_inc_not_zero(&open_file->refcount) != 0){
+            if(curproc->fd_table[fd] == of_index){
+                break;
+            }
+            open_file_put(open_file);
         }
     }
-    // find available spot in open file table 
-    for (int i = 0; i < OPEN_MAX; i++){
-		if (of_table->openfiles[i] == NULL){
-			of_index = i;
-			break;
-		}
-	}
-    
-    if(of_index == -1 || fd_temp == -1){
+
+    *ret = open_file;
+    return 0;
+}
+
+/*
+ * Give an already open vnode a descriptor. The vnode's reference
+ * passes to the open file entry; on failure it is closed.
+ */
+static int file_install(struct vnode *vn, int flags, int *ret){
+    struct open_file *of_entry;
+    int fd;
+    int err;
+
+    // find the lowest free file descriptor in cur process
+    err = fd_alloc(&fd);
+    if(err){
         vfs_close(vn);
-        lock_release(of_table->oft_lock);
-		return EMFILE;
+        return err;
     }
 
-    // create new file record
-	struct open_file *of_entry = kmalloc(sizeof(struct open_file));
-	if (of_entry == NULL) {
-		vfs_close(vn);
-		lock_release(of_table->oft_lock);
-		return ENOMEM;
-	}
+    // take a slot in the open file table
+    lock_acquire(of_table->oft_lock);
+    err = oft_alloc(&of_entry);
+    if(err){
+        lock_release(of_table->oft_lock);
+        vfs_close(vn);
+        fd_unmark(fd);
+        return err;
+    }
+	of_entry->vnode = vn;
+	of_entry->refcount = 1;	
+	of_entry->offset = 0;
+    of_entry->accmode = flags;
+	lock_release(of_table->oft_lock);
 
     /* update fd table
     fd_t: 
@@ -90,50 +275,40 @@ int sys_open(char *filename, int flags, mode_t mode, int32_t *retval){
     |f1|f2|f3|f4|f5|
      a  b  c  d  e  <--index 
     */
-	fd_table[fd_temp] = of_index;
-	
-	of_entry->vnode = vn;
-	of_entry->refcount = 1;	
-	of_entry->offset = 0;
-    of_entry->accmode = flags;
+	curproc->fd_table[fd] = of_entry->of_index;
 
-    // update global open file table
-	of_table->openfiles[of_index] = of_entry;
-    
-    // release lock for open file table
-	lock_release(of_table->oft_lock);
-
-	*retval = fd_temp;
+	*ret = fd;
     return 0;
 }
 
+int sys_open(char *filename, int flags, mode_t mode, int32_t *retval){
+    struct vnode *vn;
+    int err;
+
+    err = vfs_open(filename, flags, mode, &vn);
+    if(err){
+        return err;
+    }
+    return file_install(vn, flags, retval);
+}
+
 /* dup2 may call this function */
 int sys_close(int fd){
     if(fd < 0 || fd >= OPEN_MAX)
         return EBADF;
-    
-    lock_acquire(of_table->oft_lock);
 
     int of_index = curproc->fd_table[fd];
     if(of_index == FILE_CLOSED){
-        lock_release(of_table->oft_lock);
         return EBADF;
     }
-    struct open_file* open_file = of_table->openfiles[of_index];
+    struct open_file* open_file = open_file_at(of_index);
     
     // cleaning fd_table 
     curproc->fd_table[fd] = FILE_CLOSED;
+    fd_unmark(fd);
 
-    /* this is the last reference to the file */ 
-    if(open_file->refcount == 1){
-        vfs_close(open_file->vnode);
-        kfree(open_file);
-        of_table->openfiles[of_index] = NULL;
-    }else{
-        open_file->refcount = open_file->refcount - 1;
-    }
-
-    lock_release(of_table->oft_lock);
+    /* the file goes away once no fd or in-flight I/O refers to it */
+    open_file_put(open_file);
     return 0;
 }
 
@@ -144,142 +319,512 @@ int sys_dup2(int oldfd, int newfd, int *retval){
         newfd < 0 || newfd >= OPEN_MAX){
         return EBADF;
     }
-    /* if both fd are the same, return */ 
-    if(oldfd==newfd){
-    	*retval = newfd;
-        return 0;
-    }
 
     /* get the old and new oft index */
     int old_of_index = curproc->fd_table[oldfd];
     if(old_of_index == FILE_CLOSED){
     	return EBADF; 
     }
+
+    /* if both fd are the same, return */ 
+    if(oldfd==newfd){
+    	*retval = newfd;
+        return 0;
+    }
     
     /* if newfd is currently open, close it */
-    if(newfd != FILE_CLOSED){
+    if(curproc->fd_table[newfd] != FILE_CLOSED){
         sys_close(newfd);
     }
 
-    lock_acquire(of_table->oft_lock);
-    
-    of_table->openfiles[old_of_index]->refcount++;
-    
-    lock_release(of_table->oft_lock);
+    /* oldfd's own reference keeps the count above zero */
+    atomic_add(&open_file_at(old_of_index)->refcount, 1);
     
     /* assign new open file table reference to new fd */
-    curproc->fd_table[newfd] = curproc->fd_table[oldfd];
+    curproc->fd_table[newfd] = old_of_index;
+    fd_mark(newfd);
     *retval = newfd;
     return 0;
 }
 
-int sys_write(int fd, const void *buf, size_t nbytes, int32_t *retval){
-    if(fd < 0 || fd >= OPEN_MAX) {
-        return EBADF;
+/*
+ * Make a pipe and return its read and write descriptors in fds[0]
+ * and fds[1].
+ */
+int sys_pipe(userptr_t fds, int32_t *retval){
+    struct vnode *rvn, *wvn;
+    int kfds[2];
+    int err;
+
+    err = pipe_create(&rvn, &wvn);
+    if(err){
+        return err;
     }
-    
 
-    struct vnode *vn;
-    int of_index = curproc->fd_table[fd];
-    if(of_index == FILE_CLOSED){
-    	return EBADF; 
+    err = file_install(rvn, O_RDONLY, &kfds[0]);
+    if(err){
+        vfs_close(wvn);
+        return err;
     }
-    lock_acquire(of_table->oft_lock);
-    /* see if the fd can write */
-    if((of_table->openfiles[of_index]->accmode & O_ACCMODE) == O_RDONLY){
-        lock_release(of_table->oft_lock);
-        return EBADF;
+    err = file_install(wvn, O_WRONLY, &kfds[1]);
+    if(err){
+        sys_close(kfds[0]);
+        return err;
     }
-    vn = of_table->openfiles[of_index]->vnode; 
-    
-    struct iovec iovec; 
-    struct uio uio; 
-    
-    
-    uio_uinit(&iovec, &uio,(userptr_t)buf,nbytes,of_table->openfiles[of_index]->offset, UIO_WRITE);
-    
-    int err = VOP_WRITE(vn,&uio);
-    
+
+    err = copyout(kfds, fds, sizeof(kfds));
     if(err){
-    	lock_release(of_table->oft_lock);
-    	
-    	return err; 
-    } 
-    /* set the amount of bytes write */ 
-    *retval = uio.uio_offset - of_table->openfiles[of_index]->offset;
-    /* update offset */
-    of_table->openfiles[of_index]->offset = uio.uio_offset;
-    lock_release(of_table->oft_lock);
+        sys_close(kfds[0]);
+        sys_close(kfds[1]);
+        return err;
+    }
+
+    *retval = 0;
     return 0;
-     
 }
 
+/*
+ * Get a reference on fd's open file and check that its access mode
+ * allows the transfer direction rw.
+ */
+static int open_file_get_rw(int fd, enum uio_rw rw, struct open_file **ret){
+    struct open_file *open_file;
+    int err;
 
-int sys_read(int fd, const void *buf, size_t nbytes, int *retval){
-	if(fd < 0 || fd >= OPEN_MAX) {
+    err = open_file_get(fd, &open_file);
+    if(err){
+        return err;
+    }
+
+    /* see if the fd can read or write */
+    if((rw == UIO_READ && (open_file->accmode & O_ACCMODE) == O_WRONLY) ||
+        (rw == UIO_WRITE && (open_file->accmode & O_ACCMODE) == O_RDONLY)){
+        open_file_put(open_file);
         return EBADF;
     }
-    
-    struct vnode *vn;
-    int of_index = curproc->fd_table[fd];
-    if(of_index == FILE_CLOSED){
-    	return EBADF; 
+
+    *ret = open_file;
+    return 0;
+}
+
+/*
+ * vn has been written from start up to end: any text pages cached
+ * from it, including ones read in while the write was going on, are
+ * out of date, and so are file pages nobody has mapped. Processes
+ * already running keep the text pages they have; file pages still
+ * mapped get the written range read into them.
+ */
+static void file_written(struct vnode *vn, off_t start, off_t end){
+#if !OPT_DUMBVM
+    if(vn->vn_pages != NULL){
+        pagecache_purge(vn, false);
+        pagecache_update(vn, start, end);
     }
-   
-    lock_acquire(of_table->oft_lock);
-    /* see if the fd can read */ 
-    if((of_table->openfiles[of_index]->accmode & O_ACCMODE) == O_WRONLY){
-        lock_release(of_table->oft_lock);
-        return EBADF;
+#else
+    (void)vn;
+    (void)start;
+    (void)end;
+#endif
+}
+
+static int file_vop(struct open_file *open_file, struct uio *uio){
+    off_t start;
+    int err;
+
+    if(uio->uio_rw == UIO_READ){
+        return VOP_READ(open_file->vnode, uio);
     }
-    /* get open file vnode for reading */ 
-    vn = of_table->openfiles[of_index]->vnode; 
-    
-    struct iovec iovec; 
+    start = uio->uio_offset;
+    err = VOP_WRITE(open_file->vnode, uio);
+    file_written(open_file->vnode, start, uio->uio_offset);
+    return err;
+}
+
+/*
+ * Common body of read and write. Only the file's own of_lock is held
+ * across the VOP, so a reader blocked on the console does not stall
+ * I/O on any other open file.
+ */
+static int file_rw(int fd, struct iovec *iov, unsigned iovcnt,
+    enum uio_rw rw, int32_t *retval){
+    struct open_file *open_file;
     struct uio uio; 
-    
-    
-    uio_uinit(&iovec, &uio,(userptr_t)buf,nbytes,of_table->openfiles[of_index]->offset, UIO_READ);
-    
-    int err = VOP_READ(vn,&uio);
-    
+    int err;
+
+    err = open_file_get_rw(fd, rw, &open_file);
     if(err){
-    	lock_release(of_table->oft_lock);
-    	return err; 
-    }  
-    /* set the amount of bytes read */
-    *retval = uio.uio_offset - of_table->openfiles[of_index]->offset;
-
-    /* update offset */
-    of_table->openfiles[of_index]->offset = uio.uio_offset;
-    lock_release(of_table->oft_lock);
+        return err;
+    }
+
+    lock_acquire(open_file->of_lock);
+
+    uio_uinitv(iov, iovcnt, &uio, open_file->offset, rw);
+
+    err = file_vop(open_file, &uio);
+    if(!err){
+        /* set the amount of bytes transferred */
+        *retval = uio.uio_offset - open_file->offset;
+        /* update offset */
+        open_file->offset = uio.uio_offset;
+    }
+
+    lock_release(open_file->of_lock);
+    open_file_put(open_file);
+    return err;
+}
+
+/*
+ * Common body of pread and pwrite. The caller's position is used
+ * as-is; the shared offset is neither read nor locked, so workers on
+ * disjoint ranges of one open file run in parallel.
+ */
+static int file_prw(int fd, struct iovec *iov, unsigned iovcnt, off_t pos,
+    enum uio_rw rw, int32_t *retval){
+    struct open_file *open_file;
+    struct uio uio; 
+    int err;
+
+    if(pos < 0){
+        return EINVAL;
+    }
+
+    err = open_file_get_rw(fd, rw, &open_file);
+    if(err){
+        return err;
+    }
+
+    /* positional I/O makes no sense on the console and friends */
+    if(!VOP_ISSEEKABLE(open_file->vnode)){
+        open_file_put(open_file);
+        return ESPIPE;
+    }
+
+    uio_uinitv(iov, iovcnt, &uio, pos, rw);
+
+    err = file_vop(open_file, &uio);
+    if(!err){
+        *retval = uio.uio_offset - pos;
+    }
+
+    open_file_put(open_file);
+    return err;
+}
+
+/* the single-buffer calls are the one-element case of the vector ones */
+static int file_rw1(int fd, userptr_t buf, size_t nbytes, off_t pos,
+    bool positional, enum uio_rw rw, int32_t *retval){
+    struct iovec iovec;
+
+    iovec.iov_ubase = buf;
+    iovec.iov_len = nbytes;
+    if(positional){
+        return file_prw(fd, &iovec, 1, pos, rw, retval);
+    }
+    return file_rw(fd, &iovec, 1, rw, retval);
+}
+
+/*
+ * Copy a user iovec array into the kernel with a single copyin and
+ * check it. Arrays of up to FILE_FASTIOV entries land in the
+ * caller's stack buffer FAST; larger ones are kmalloc'd and must be
+ * kfree'd by the caller when *ret != fast.
+ */
+static int iovec_copyin(userptr_t uiov, int iovcnt, struct iovec *fast,
+    struct iovec **ret){
+    struct iovec *iov;
+    size_t total = 0;
+    int err;
+
+    if(iovcnt <= 0 || iovcnt > IOV_MAX){
+        return EINVAL;
+    }
+
+    iov = fast;
+    if(iovcnt > FILE_FASTIOV){
+        iov = kmalloc(iovcnt * sizeof(struct iovec));
+        if(iov == NULL){
+            return ENOMEM;
+        }
+    }
+
+    err = copyin(uiov, iov, iovcnt * sizeof(struct iovec));
+    if(err){
+        goto fail;
+    }
+
+    /* the total has to fit in the (signed) return value */
+    for(int i = 0; i < iovcnt; i++){
+        if(total + iov[i].iov_len < total ||
+            (ssize_t)(total + iov[i].iov_len) < 0){
+            err = EINVAL;
+            goto fail;
+        }
+        total += iov[i].iov_len;
+    }
+
+    *ret = iov;
     return 0;
+
+fail:
+    if(iov != fast){
+        kfree(iov);
+    }
+    return err;
 }
 
+/*
+ * Common body of readv/writev/preadv/pwritev: the whole user iovec
+ * array goes to VOP_READ/VOP_WRITE as one uio.
+ */
+static int file_rwv(int fd, userptr_t uiov, int iovcnt, off_t pos,
+    bool positional, enum uio_rw rw, int32_t *retval){
+    struct iovec fast[FILE_FASTIOV];
+    struct iovec *iov;
+    int err;
 
-int sys_lseek(int fd, off_t pos, int whence, off_t *retval64){
+    err = iovec_copyin(uiov, iovcnt, fast, &iov);
+    if(err){
+        return err;
+    }
+
+    if(positional){
+        err = file_prw(fd, iov, iovcnt, pos, rw, retval);
+    }else{
+        err = file_rw(fd, iov, iovcnt, rw, retval);
+    }
+
+    if(iov != fast){
+        kfree(iov);
+    }
+    return err;
+}
+
+int sys_write(int fd, const void *buf, size_t nbytes, int32_t *retval){
+    return file_rw1(fd, (userptr_t)buf, nbytes, 0, false, UIO_WRITE, retval);
+}
+
+
+int sys_read(int fd, const void *buf, size_t nbytes, int *retval){
+    return file_rw1(fd, (userptr_t)buf, nbytes, 0, false, UIO_READ, retval);
+}
+
+int sys_pread(int fd, void *buf, size_t nbytes, off_t pos, int32_t *retval){
+    return file_rw1(fd, (userptr_t)buf, nbytes, pos, true, UIO_READ, retval);
+}
+
+int sys_pwrite(int fd, const void *buf, size_t nbytes, off_t pos,
+    int32_t *retval){
+    return file_rw1(fd, (userptr_t)buf, nbytes, pos, true, UIO_WRITE, retval);
+}
+
+int sys_readv(int fd, userptr_t iov, int iovcnt, int32_t *retval){
+    return file_rwv(fd, iov, iovcnt, 0, false, UIO_READ, retval);
+}
+
+int sys_writev(int fd, userptr_t iov, int iovcnt, int32_t *retval){
+    return file_rwv(fd, iov, iovcnt, 0, false, UIO_WRITE, retval);
+}
+
+int sys_preadv(int fd, userptr_t iov, int iovcnt, off_t pos,
+    int32_t *retval){
+    return file_rwv(fd, iov, iovcnt, pos, true, UIO_READ, retval);
+}
+
+int sys_pwritev(int fd, userptr_t iov, int iovcnt, off_t pos,
+    int32_t *retval){
+    return file_rwv(fd, iov, iovcnt, pos, true, UIO_WRITE, retval);
+}
+
+/*
+ * Move up to len bytes from in at *inpos to out at *outpos through
+ * the kernel buffer buf, advancing both positions. Stops early at
+ * end of file. Each chunk is one VOP_READ and one VOP_WRITE, so SFS
+ * can move a block-aligned chunk with one DEVOP_IO per side.
+ */
+static int file_copy(struct vnode *in, off_t *inpos, struct vnode *out,
+    off_t *outpos, size_t len, char *buf, size_t buflen, size_t *copied){
+    struct iovec iov;
+    struct uio uio;
+    size_t chunk, got;
+    int err = 0;
+
+    *copied = 0;
+    while(*copied < len){
+        chunk = len - *copied;
+        if(chunk > buflen){
+            chunk = buflen;
+        }
+
+        uio_kinit(&iov, &uio, buf, chunk, *inpos, UIO_READ);
+        err = VOP_READ(in, &uio);
+        if(err){
+            break;
+        }
+        got = chunk - uio.uio_resid;
+        if(got == 0){
+            /* end of file */
+            break;
+        }
+
+        /* the input only advances past what actually got written */
+        uio_kinit(&iov, &uio, buf, got, *outpos, UIO_WRITE);
+        err = VOP_WRITE(out, &uio);
+        file_written(out, *outpos, uio.uio_offset);
+        *inpos += got - uio.uio_resid;
+        *outpos = uio.uio_offset;
+        *copied += got - uio.uio_resid;
+        if(err){
+            break;
+        }
+        if(uio.uio_resid != 0){
+            /* the output filled up */
+            break;
+        }
+    }
+    return err;
+}
+
+/*
+ * copy_file_range: copy data between two open files without taking
+ * it out to user space. A NULL position pointer means use (and
+ * advance) that file's own offset, which is then locked for the
+ * whole copy; otherwise the position is read from and written back
+ * to user memory and the file's offset is left alone.
+ */
+int sys_copy_file_range(int infd, userptr_t uinpos, int outfd,
+    userptr_t uoutpos, size_t len, unsigned flags, int32_t *retval){
+    struct open_file *in, *out, *first, *second;
+    off_t inpos, outpos;
+    char *buf;
+    size_t buflen, copied;
     int err;
 
-    if(fd < 0 || fd >= OPEN_MAX){
-        return EBADF;
+    if(flags != 0){
+        return EINVAL;
     }
+    /* the count has to fit in the (signed) return value */
+    if((ssize_t)len < 0){
+        len = ~(size_t)0 >> 1;
+    }
+
+    err = open_file_get_rw(infd, UIO_READ, &in);
+    if(err){
+        return err;
+    }
+    err = open_file_get_rw(outfd, UIO_WRITE, &out);
+    if(err){
+        open_file_put(in);
+        return err;
+    }
+
+    /* reading and writing one file at once would need overlap checks */
+    if(in->vnode == out->vnode){
+        err = EINVAL;
+        goto put;
+    }
+    if((uinpos != NULL && !VOP_ISSEEKABLE(in->vnode)) ||
+        (uoutpos != NULL && !VOP_ISSEEKABLE(out->vnode))){
+        err = ESPIPE;
+        goto put;
+    }
+    if(uinpos != NULL){
+        err = copyin(uinpos, &inpos, sizeof(inpos));
+        if(err){
+            goto put;
+        }
+    }
+    if(uoutpos != NULL){
+        err = copyin(uoutpos, &outpos, sizeof(outpos));
+        if(err){
+            goto put;
+        }
+    }
+    if((uinpos != NULL && inpos < 0) || (uoutpos != NULL && outpos < 0)){
+        err = EINVAL;
+        goto put;
+    }
+
+    buflen = FILE_COPYBUF;
+    buf = kmalloc(buflen);
+    if(buf == NULL){
+        buflen = PAGE_SIZE;
+        buf = kmalloc(buflen);
+        if(buf == NULL){
+            err = ENOMEM;
+            goto put;
+        }
+    }
+
+    /* always lock in table order so two crossed copies can't deadlock */
+    first = in->of_index < out->of_index ? in : out;
+    second = first == in ? out : in;
+    if(first == in ? uinpos == NULL : uoutpos == NULL){
+        lock_acquire(first->of_lock);
+    }
+    if(second == in ? uinpos == NULL : uoutpos == NULL){
+        lock_acquire(second->of_lock);
+    }
+    if(uinpos == NULL){
+        inpos = in->offset;
+    }
+    if(uoutpos == NULL){
+        outpos = out->offset;
+    }
+
+    err = file_copy(in->vnode, &inpos, out->vnode, &outpos, len,
+        buf, buflen, &copied);
+
+    if(uoutpos == NULL){
+        out->offset = outpos;
+        lock_release(out->of_lock);
+    }
+    if(uinpos == NULL){
+        in->offset = inpos;
+        lock_release(in->of_lock);
+    }
+    kfree(buf);
+
+    /* like write, report a partial copy rather than the error */
+    if(copied > 0){
+        err = 0;
+    }
+    if(!err && uinpos != NULL){
+        err = copyout(&inpos, uinpos, sizeof(inpos));
+    }
+    if(!err && uoutpos != NULL){
+        err = copyout(&outpos, uoutpos, sizeof(outpos));
+    }
+    if(!err){
+        *retval = copied;
+    }
+
+put:
+    open_file_put(out);
+    open_file_put(in);
+    return err;
+}
+
+
+int sys_lseek(int fd, off_t pos, int whence, off_t *retval64){
+    struct open_file *open_file;
+    int err;
+
     if(whence != SEEK_CUR && whence != SEEK_END && whence != SEEK_SET){
         return EINVAL;
     }
-    int of_index = curproc->fd_table[fd];
-    if(of_index == FILE_CLOSED){
-        return EBADF;
+    err = open_file_get(fd, &open_file);
+    if(err){
+        return err;
     }
 
-    // lock global open file table
-    lock_acquire(of_table->oft_lock);
-    
-    struct open_file *open_file = of_table->openfiles[of_index];
-    
     if(!VOP_ISSEEKABLE(open_file->vnode)){
-        lock_release(of_table->oft_lock);
+        open_file_put(open_file);
         return ESPIPE;
     }
+
+    // lock this file's offset
+    lock_acquire(open_file->of_lock);
+
     struct stat s;
     off_t original = open_file->offset;
     switch(whence){
@@ -294,7 +839,8 @@ int sys_lseek(int fd, off_t pos, int whence, off_t *retval64){
         case SEEK_END:
         err = VOP_STAT(open_file->vnode, &s);
         if(err){
-            lock_release(of_table->oft_lock);
+            lock_release(open_file->of_lock);
+            open_file_put(open_file);
             return err;
         }
         open_file->offset = pos + s.st_size;
@@ -305,12 +851,62 @@ int sys_lseek(int fd, off_t pos, int whence, off_t *retval64){
     // restore it to previous offset
     if(open_file->offset < 0){
         open_file->offset = original;
-        lock_release(of_table->oft_lock);
+        lock_release(open_file->of_lock);
+        open_file_put(open_file);
         return EINVAL;
     }
 
     *retval64 = open_file->offset;
-    lock_release(of_table->oft_lock);
+    lock_release(open_file->of_lock);
+    open_file_put(open_file);
+    return 0;
+}
+
+int file_poll(int fd, int events, int *revents){
+    struct open_file *open_file;
+    int err;
+
+    err = open_file_get(fd, &open_file);
+    if(err){
+        return err;
+    }
+    err = VOP_POLL(open_file->vnode, events, revents);
+    open_file_put(open_file);
+    return err;
+}
+
+/*
+ * Get the vnode behind fd, with a reference of its own, for mmap,
+ * and the file's size. Any mapping reads the file, and a writable
+ * shared one writes it too, so fd must have been opened for that.
+ */
+int file_mmap(int fd, bool write, struct vnode **ret, off_t *size){
+    struct open_file *open_file;
+    struct stat st;
+    int err;
+
+    err = open_file_get(fd, &open_file);
+    if(err){
+        return err;
+    }
+    if((open_file->accmode & O_ACCMODE) == O_WRONLY ||
+        (write && (open_file->accmode & O_ACCMODE) != O_RDWR)){
+        open_file_put(open_file);
+        return EACCES;
+    }
+    err = VOP_MMAP(open_file->vnode);
+    if(!err){
+        err = VOP_STAT(open_file->vnode, &st);
+    }
+    if(err){
+        open_file_put(open_file);
+        return err;
+    }
+
+    VOP_INCREF(open_file->vnode);
+    *ret = open_file->vnode;
+    *size = st.st_size;
+    open_file_put(open_file);
     return 0;
 }
 
@@ -322,6 +918,9 @@ int fd_table_init(void){
     for(fd = 0; fd < OPEN_MAX; fd++){
         curproc->fd_table[fd] = FILE_CLOSED;
     }
+    for(fd = 0; fd < FD_BITMAP_WORDS; fd++){
+        curproc->fd_bitmap[fd] = 0;
+    }
 
     int err = std_init();
     if(err){
@@ -330,11 +929,41 @@ int fd_table_init(void){
 	return 0;
 }
 
+/*
+ * The child shares each open file, offset included, with the parent,
+ * so it only takes another reference. The parent's own references
+ * keep every count above zero.
+ */
+void fd_table_copy(struct proc *child){
+    int fd;
+
+    for(fd = 0; fd < OPEN_MAX; fd++){
+        child->fd_table[fd] = curproc->fd_table[fd];
+        if(child->fd_table[fd] != FILE_CLOSED){
+            atomic_add(&open_file_at(child->fd_table[fd])->refcount, 1);
+        }
+    }
+    for(fd = 0; fd < FD_BITMAP_WORDS; fd++){
+        child->fd_bitmap[fd] = curproc->fd_bitmap[fd];
+    }
+}
+
+void fd_table_destroy(struct proc *proc){
+    int fd;
+
+    for(fd = 0; fd < OPEN_MAX; fd++){
+        if(proc->fd_table[fd] != FILE_CLOSED){
+            open_file_put(open_file_at(proc->fd_table[fd]));
+            proc->fd_table[fd] = FILE_CLOSED;
+        }
+    }
+    for(fd = 0; fd < FD_BITMAP_WORDS; fd++){
+        proc->fd_bitmap[fd] = 0;
+    }
+}
 
 /* init global open file table */
 int open_file_table_init(void){
-    int i;
-    
     of_table = kmalloc(sizeof(struct file_table));
     if (of_table == NULL){
         return ENOMEM;
@@ -347,9 +976,11 @@ int open_file_table_init(void){
     }
     of_table->oft_lock = oft_lock;
 
-    /* empty the table */
-    for (i = 0; i < OPEN_MAX; i++){
-        of_table->openfiles[i] = NULL;
+    /* start empty; slabs are added as files get opened */
+    for(int i = 0; i < OFT_MAX_DIRS; i++){
+        of_table->dirs[i] = NULL;
     }
+    of_table->nslabs = 0;
+    of_table->freelist = NULL;
     return 0;
 }
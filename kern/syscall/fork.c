@@ -0,0 +1,57 @@
+/*
+ * fork(). The child runs in a new thread on a copy of the parent's
+ * trapframe and returns 0 from the same system call; the parent gets
+ * the child's pid. Nothing of the address space is copied up front:
+ * see proc_fork and as_copy.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <mips/trapframe.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <syscall.h>
+
+/* first thing the child thread runs; DATA1 is its trapframe copy */
+static
+void
+fork_child(void *data1, unsigned long data2)
+{
+	(void)data2;
+
+	as_activate();
+	enter_forked_process(data1);
+}
+
+int
+sys_fork(struct trapframe *tf, int32_t *retval)
+{
+	struct trapframe *childtf;
+	struct proc *child;
+	int err;
+
+	childtf = kmalloc(sizeof(*childtf));
+	if (childtf == NULL) {
+		return ENOMEM;
+	}
+	*childtf = *tf;
+
+	err = proc_fork(&child);
+	if (err) {
+		kfree(childtf);
+		return err;
+	}
+
+	err = thread_fork(curthread->t_name, child, fork_child, childtf, 0);
+	if (err) {
+		proc_destroy(child);
+		kfree(childtf);
+		return err;
+	}
+
+	*retval = child->p_pid;
+	return 0;
+}
@@ -0,0 +1,260 @@
+/*
+ * Batched I/O submission ring: ioring_setup() and ioring_enter().
+ *
+ * The ring layout is in <kern/ioring.h>. The ring is ordinary user
+ * memory registered once per process; each ioring_enter() copies in
+ * a batch of sqes, runs them through the normal file syscall code,
+ * and copies the completions and the new head/tail back out. A
+ * whole batch costs one trap instead of one per request.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/ioring.h>
+#include <lib.h>
+#include <limits.h>
+#include <current.h>
+#include <proc.h>
+#include <vm.h>
+#include <file.h>
+#include <syscall.h>
+#include <copyinout.h>
+
+/* requests copied in and completed per round trip to user memory */
+#define IORING_BATCH 16
+
+int
+sys_ioring_setup(userptr_t ring, unsigned entries)
+{
+	struct ioring hdr;
+	vaddr_t base = (vaddr_t)ring;
+	int err;
+
+	if (entries == 0 || entries > IORING_MAX_ENTRIES ||
+	    (entries & (entries - 1)) != 0) {
+		return EINVAL;
+	}
+	/* sqes and cqes hold 64-bit fields */
+	if ((base & 7) != 0) {
+		return EINVAL;
+	}
+	if (base + IORING_SIZE(entries) < base ||
+	    base + IORING_SIZE(entries) > USERSPACETOP) {
+		return EFAULT;
+	}
+
+	hdr.ir_sq_head = 0;
+	hdr.ir_sq_tail = 0;
+	hdr.ir_cq_head = 0;
+	hdr.ir_cq_tail = 0;
+	hdr.ir_entries = entries;
+	hdr.ir_pad = 0;
+	err = copyout(&hdr, ring, sizeof(hdr));
+	if (err) {
+		return err;
+	}
+
+	curproc->p_ioring = ring;
+	curproc->p_ioring_entries = entries;
+	return 0;
+}
+
+/*
+ * Run one request. Returns the syscall's return value, or -errno.
+ * PATHBUF is allocated the first time the batch needs a pathname.
+ */
+static
+__i64
+ioring_do(const struct ioring_sqe *sqe, char **pathbuf)
+{
+	int32_t ret32 = 0;
+	off_t ret64;
+	userptr_t addr = (userptr_t)sqe->sqe_addr;
+	bool pos = (sqe->sqe_flags & IORING_F_POS) != 0;
+	int err;
+
+	switch (sqe->sqe_op) {
+	    case IORING_OP_NOP:
+		err = 0;
+		break;
+
+	    case IORING_OP_READ:
+		if (pos) {
+			err = sys_pread(sqe->sqe_fd, addr, sqe->sqe_len,
+					sqe->sqe_off, &ret32);
+		}
+		else {
+			err = sys_read(sqe->sqe_fd, addr, sqe->sqe_len,
+				       &ret32);
+		}
+		break;
+
+	    case IORING_OP_WRITE:
+		if (pos) {
+			err = sys_pwrite(sqe->sqe_fd, addr, sqe->sqe_len,
+					 sqe->sqe_off, &ret32);
+		}
+		else {
+			err = sys_write(sqe->sqe_fd, addr, sqe->sqe_len,
+					&ret32);
+		}
+		break;
+
+	    case IORING_OP_LSEEK:
+		err = sys_lseek(sqe->sqe_fd, sqe->sqe_off, sqe->sqe_flags,
+				&ret64);
+		if (err) {
+			break;
+		}
+		return ret64;
+
+	    case IORING_OP_OPEN:
+		if (*pathbuf == NULL) {
+			*pathbuf = kmalloc(PATH_MAX);
+			if (*pathbuf == NULL) {
+				err = ENOMEM;
+				break;
+			}
+		}
+		err = copyinstr(addr, *pathbuf, PATH_MAX, NULL);
+		if (err) {
+			break;
+		}
+		err = sys_open(*pathbuf, sqe->sqe_len, 0, &ret32);
+		break;
+
+	    case IORING_OP_CLOSE:
+		err = sys_close(sqe->sqe_fd);
+		break;
+
+	    default:
+		err = EINVAL;
+		break;
+	}
+
+	if (err) {
+		return -(__i64)err;
+	}
+	return ret32;
+}
+
+/*
+ * Copy N completions to the cq starting at free-running index TAIL,
+ * wrapping at most once.
+ */
+static
+int
+ioring_post(userptr_t ring, unsigned entries, uint32_t tail,
+	    const struct ioring_cqe *cqes, unsigned n)
+{
+	userptr_t cq = ring + IORING_CQ_OFFSET(entries);
+	unsigned idx = tail & (entries - 1);
+	unsigned first = n;
+	int err;
+
+	if (first > entries - idx) {
+		first = entries - idx;
+	}
+	err = copyout(cqes, cq + idx * sizeof(*cqes), first * sizeof(*cqes));
+	if (err) {
+		return err;
+	}
+	if (first < n) {
+		err = copyout(cqes + first, cq, (n - first) * sizeof(*cqes));
+	}
+	return err;
+}
+
+int
+sys_ioring_enter(unsigned to_submit, int32_t *retval)
+{
+	struct ioring_sqe sqes[IORING_BATCH];
+	struct ioring_cqe cqes[IORING_BATCH];
+	struct ioring hdr;
+	userptr_t ring = curproc->p_ioring;
+	unsigned entries = curproc->p_ioring_entries;
+	unsigned queued, space, done, n, idx, i;
+	char *pathbuf = NULL;
+	int err;
+
+	if (ring == NULL) {
+		return EINVAL;
+	}
+
+	err = copyin(ring, &hdr, sizeof(hdr));
+	if (err) {
+		return err;
+	}
+
+	/* trust our own idea of the size, not the user's copy */
+	queued = hdr.ir_sq_tail - hdr.ir_sq_head;
+	space = entries - (hdr.ir_cq_tail - hdr.ir_cq_head);
+	if (queued > entries || space > entries) {
+		return EINVAL;
+	}
+	if (to_submit > queued) {
+		to_submit = queued;
+	}
+	/* never complete more than the user has room to reap */
+	if (to_submit > space) {
+		to_submit = space;
+	}
+
+	done = 0;
+	while (done < to_submit) {
+		n = to_submit - done;
+		if (n > IORING_BATCH) {
+			n = IORING_BATCH;
+		}
+		/* take a contiguous run of sqes; the rest next time round */
+		idx = hdr.ir_sq_head & (entries - 1);
+		if (n > entries - idx) {
+			n = entries - idx;
+		}
+
+		err = copyin(ring + IORING_SQ_OFFSET + idx * sizeof(sqes[0]),
+			     sqes, n * sizeof(sqes[0]));
+		if (err) {
+			break;
+		}
+
+		for (i = 0; i < n; i++) {
+			cqes[i].cqe_res = ioring_do(&sqes[i], &pathbuf);
+			cqes[i].cqe_data = sqes[i].sqe_data;
+			cqes[i].cqe_pad = 0;
+		}
+
+		err = ioring_post(ring, entries, hdr.ir_cq_tail, cqes, n);
+		if (err) {
+			break;
+		}
+		hdr.ir_sq_head += n;
+		hdr.ir_cq_tail += n;
+		done += n;
+	}
+
+	if (pathbuf != NULL) {
+		kfree(pathbuf);
+	}
+
+	/*
+	 * Publish progress even if a later batch faulted. The process
+	 * has one thread and it is in here, so nobody can be updating
+	 * ir_sq_tail or ir_cq_head behind our back and the whole
+	 * header can be written back at once.
+	 */
+	if (done > 0) {
+		hdr.ir_entries = entries;
+		err = copyout(&hdr, ring, sizeof(hdr));
+		if (err) {
+			return err;
+		}
+		*retval = done;
+		return 0;
+	}
+	if (err) {
+		return err;
+	}
+	*retval = 0;
+	return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * sbrk, mmap, munmap and msync. The work is done by as_sbrk, as_mmap
+ * and friends and by the page fault handler; see <kern/mman.h> for
+ * the flags.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/mman.h>
+#include <lib.h>
+#include <proc.h>
+#include <vnode.h>
+#include <addrspace.h>
+#include <file.h>
+#include <syscall.h>
+
+/*
+ * Moves the break only; the pages are allocated as they are touched.
+ */
+int
+sys_sbrk(intptr_t amount, int32_t *retval)
+{
+	vaddr_t oldbreak;
+	int result;
+
+	result = as_sbrk(proc_getas(), amount, &oldbreak);
+	if (result) {
+		return result;
+	}
+	*retval = (int32_t)oldbreak;
+	return 0;
+}
+
+/*
+ * Only PROT_WRITE is enforced: the TLB cannot refuse reads, so
+ * PROT_NONE maps the file readable. With MAP_FIXED the range must
+ * not overlap anything already mapped.
+ */
+int
+sys_mmap(vaddr_t addr, size_t len, int prot, int flags, int fd,
+	 off_t offset, int32_t *retval)
+{
+	struct vnode *vn;
+	off_t size;
+	size_t filesz;
+	bool write;
+	int result;
+
+	if (len == 0 || offset < 0 || (offset & (PAGE_SIZE - 1)) != 0) {
+		return EINVAL;
+	}
+	if ((flags & ~(MAP_TYPE | MAP_FIXED)) != 0 ||
+	    ((flags & MAP_TYPE) != MAP_SHARED &&
+	     (flags & MAP_TYPE) != MAP_PRIVATE)) {
+		return EINVAL;
+	}
+	if ((flags & MAP_FIXED) && (addr & ~(vaddr_t)PAGE_FRAME) != 0) {
+		return EINVAL;
+	}
+	write = (prot & PROT_WRITE) != 0;
+
+	result = file_mmap(fd, write && (flags & MAP_TYPE) == MAP_SHARED,
+			   &vn, &size);
+	if (result) {
+		return result;
+	}
+
+	/* how much of the mapping the file covers right now */
+	filesz = 0;
+	if (offset < size) {
+		filesz = size - offset < (off_t)len ? size - offset : len;
+	}
+
+	result = as_mmap(proc_getas(), &addr, len, write, flags, vn, offset,
+			 filesz);
+	if (result) {
+		VOP_DECREF(vn);
+		return result;
+	}
+	*retval = (int32_t)addr;
+	return 0;
+}
+
+int
+sys_munmap(vaddr_t addr, size_t len)
+{
+	if (len == 0 || (addr & ~(vaddr_t)PAGE_FRAME) != 0) {
+		return EINVAL;
+	}
+	return as_munmap(proc_getas(), addr, len);
+}
+
+/* Writes back synchronously whatever FLAGS asks for. */
+int
+sys_msync(vaddr_t addr, size_t len, int flags)
+{
+	if ((addr & ~(vaddr_t)PAGE_FRAME) != 0 ||
+	    (flags & ~(MS_ASYNC | MS_SYNC | MS_INVALIDATE)) != 0 ||
+	    (flags & (MS_ASYNC | MS_SYNC)) == (MS_ASYNC | MS_SYNC)) {
+		return EINVAL;
+	}
+	return as_msync(proc_getas(), addr, len);
+}
@@ -0,0 +1,325 @@
+/*
+ * poll() and select().
+ *
+ * Both boil down to asking VOP_POLL about each descriptor in turn
+ * and, if nothing is ready, going to sleep until something might
+ * be. There is one wait channel for all pollers. poll_gen counts
+ * calls to poll_wakeup(); a poller notes it before scanning and
+ * only sleeps if it has not moved since, so a wakeup that comes in
+ * while the scan is running is never lost. Pollers with a timeout
+ * are also woken every tick by poll_hardclock() to check the time.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/limits.h>
+#include <kern/poll.h>
+#include <kern/select.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <wchan.h>
+#include <clock.h>
+#include <cpu.h>
+#include <current.h>
+#include <copyinout.h>
+#include <file.h>
+#include <syscall.h>
+#include <poll.h>
+
+/* pollfd arrays up to this size are copied in onto the kernel stack */
+#define POLL_FASTFDS 8
+
+static struct spinlock poll_lock = SPINLOCK_INITIALIZER;
+static struct wchan *poll_wchan;
+static unsigned poll_gen;		/* poll_wakeup() calls so far */
+static volatile unsigned poll_ntimed;	/* sleepers with a timeout */
+
+/* look at every descriptor once; count the ready ones in *NREADY */
+typedef int (*poll_scan_fn)(void *data, unsigned *nready);
+
+void
+poll_bootstrap(void)
+{
+	poll_wchan = wchan_create("poll");
+	if (poll_wchan == NULL) {
+		panic("Couldn't create poll wchan\n");
+	}
+}
+
+void
+poll_wakeup(void)
+{
+	spinlock_acquire(&poll_lock);
+	poll_gen++;
+	wchan_wakeall(poll_wchan, &poll_lock);
+	spinlock_release(&poll_lock);
+}
+
+void
+poll_hardclock(void)
+{
+	/* one cpu is enough; the check is racy but only costs a tick */
+	if (curcpu->c_number == 0 && poll_ntimed > 0) {
+		poll_wakeup();
+	}
+}
+
+/*
+ * Scan until something is ready, TIMEOUT (NULL for no limit) runs
+ * out, or the scan fails.
+ */
+static
+int
+poll_wait(poll_scan_fn scan, void *data, const struct timespec *timeout,
+	  unsigned *nready)
+{
+	struct timespec now, deadline;
+	unsigned gen;
+	int err;
+
+	if (timeout != NULL) {
+		gettime(&now);
+		timespec_add(&now, timeout, &deadline);
+	}
+
+	while (1) {
+		spinlock_acquire(&poll_lock);
+		gen = poll_gen;
+		spinlock_release(&poll_lock);
+
+		err = scan(data, nready);
+		if (err || *nready > 0) {
+			return err;
+		}
+
+		if (timeout != NULL) {
+			gettime(&now);
+			if (now.tv_sec > deadline.tv_sec ||
+			    (now.tv_sec == deadline.tv_sec &&
+			     now.tv_nsec >= deadline.tv_nsec)) {
+				return 0;
+			}
+		}
+
+		spinlock_acquire(&poll_lock);
+		if (gen == poll_gen) {
+			/* nothing has changed since the scan began */
+			if (timeout != NULL) {
+				poll_ntimed++;
+			}
+			wchan_sleep(poll_wchan, &poll_lock);
+			if (timeout != NULL) {
+				poll_ntimed--;
+			}
+		}
+		spinlock_release(&poll_lock);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// poll
+
+struct poll_args {
+	struct pollfd *pa_fds;
+	unsigned pa_nfds;
+};
+
+static
+int
+poll_scan(void *data, unsigned *nready)
+{
+	struct poll_args *pa = data;
+	struct pollfd *pfd;
+	int events, revents;
+	unsigned i;
+
+	*nready = 0;
+	for (i = 0; i < pa->pa_nfds; i++) {
+		pfd = &pa->pa_fds[i];
+		pfd->revents = 0;
+		if (pfd->fd < 0) {
+			continue;
+		}
+		events = pfd->events | POLLERR | POLLHUP;
+		if (file_poll(pfd->fd, events, &revents)) {
+			revents = POLLNVAL;
+		}
+		pfd->revents = revents & (events | POLLNVAL);
+		if (pfd->revents != 0) {
+			(*nready)++;
+		}
+	}
+	return 0;
+}
+
+int
+sys_poll(userptr_t ufds, unsigned nfds, int timeout_ms, int32_t *retval)
+{
+	struct pollfd fast[POLL_FASTFDS];
+	struct poll_args pa;
+	struct timespec timeout;
+	unsigned nready;
+	int err;
+
+	if (nfds > OPEN_MAX) {
+		return EINVAL;
+	}
+
+	pa.pa_nfds = nfds;
+	pa.pa_fds = fast;
+	if (nfds > POLL_FASTFDS) {
+		pa.pa_fds = kmalloc(nfds * sizeof(struct pollfd));
+		if (pa.pa_fds == NULL) {
+			return ENOMEM;
+		}
+	}
+
+	err = copyin(ufds, pa.pa_fds, nfds * sizeof(struct pollfd));
+	if (err) {
+		goto out;
+	}
+
+	/* a negative timeout means wait forever */
+	if (timeout_ms >= 0) {
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_nsec = (timeout_ms % 1000) * 1000000;
+	}
+	err = poll_wait(poll_scan, &pa, timeout_ms >= 0 ? &timeout : NULL,
+			&nready);
+	if (err) {
+		goto out;
+	}
+
+	err = copyout(pa.pa_fds, ufds, nfds * sizeof(struct pollfd));
+	if (err) {
+		goto out;
+	}
+	*retval = nready;
+
+ out:
+	if (pa.pa_fds != fast) {
+		kfree(pa.pa_fds);
+	}
+	return err;
+}
+
+////////////////////////////////////////////////////////////
+// select
+
+struct select_args {
+	int sa_nfds;
+	fd_set sa_in[3];	/* read, write, except as passed in */
+	fd_set sa_out[3];	/* and as handed back */
+};
+
+static
+int
+select_scan(void *data, unsigned *nready)
+{
+	struct select_args *sa = data;
+	int fd, events, revents;
+	bool except;
+	int err;
+
+	*nready = 0;
+	FD_ZERO(&sa->sa_out[0]);
+	FD_ZERO(&sa->sa_out[1]);
+	FD_ZERO(&sa->sa_out[2]);
+
+	for (fd = 0; fd < sa->sa_nfds; fd++) {
+		events = 0;
+		if (FD_ISSET(fd, &sa->sa_in[0])) {
+			events |= POLLIN;
+		}
+		if (FD_ISSET(fd, &sa->sa_in[1])) {
+			events |= POLLOUT;
+		}
+		except = FD_ISSET(fd, &sa->sa_in[2]);
+		if (events == 0 && !except) {
+			continue;
+		}
+
+		err = file_poll(fd, events | POLLERR | POLLHUP, &revents);
+		if (err) {
+			return err;
+		}
+		/* errors and hangups make reads and writes not block */
+		if (revents & (POLLERR | POLLHUP)) {
+			revents |= events;
+		}
+		if (revents & events & POLLIN) {
+			FD_SET(fd, &sa->sa_out[0]);
+			(*nready)++;
+		}
+		if (revents & events & POLLOUT) {
+			FD_SET(fd, &sa->sa_out[1]);
+			(*nready)++;
+		}
+		/* there is never any out-of-band data to report */
+	}
+	return 0;
+}
+
+int
+sys_select(int nfds, userptr_t readfds, userptr_t writefds,
+	   userptr_t exceptfds, userptr_t utimeout, int32_t *retval)
+{
+	struct select_args *sa;
+	userptr_t usets[3] = { readfds, writefds, exceptfds };
+	struct timeval tv;
+	struct timespec timeout;
+	unsigned nready;
+	int i, err;
+
+	if (nfds < 0 || nfds > FD_SETSIZE) {
+		return EINVAL;
+	}
+
+	if (utimeout != NULL) {
+		err = copyin(utimeout, &tv, sizeof(tv));
+		if (err) {
+			return err;
+		}
+		if (tv.tv_sec < 0 || tv.tv_usec < 0 || tv.tv_usec >= 1000000) {
+			return EINVAL;
+		}
+		timeout.tv_sec = tv.tv_sec;
+		timeout.tv_nsec = tv.tv_usec * 1000;
+	}
+
+	/* six fd_sets are a bit much for the kernel stack */
+	sa = kmalloc(sizeof(*sa));
+	if (sa == NULL) {
+		return ENOMEM;
+	}
+	sa->sa_nfds = nfds;
+	for (i = 0; i < 3; i++) {
+		FD_ZERO(&sa->sa_in[i]);
+		if (usets[i] != NULL) {
+			err = copyin(usets[i], &sa->sa_in[i], sizeof(fd_set));
+			if (err) {
+				goto out;
+			}
+		}
+	}
+
+	err = poll_wait(select_scan, sa, utimeout != NULL ? &timeout : NULL,
+			&nready);
+	if (err) {
+		goto out;
+	}
+
+	for (i = 0; i < 3; i++) {
+		if (usets[i] != NULL) {
+			err = copyout(&sa->sa_out[i], usets[i], sizeof(fd_set));
+			if (err) {
+				goto out;
+			}
+		}
+	}
+	*retval = nready;
+
+ out:
+	kfree(sa);
+	return err;
+}
@@ -0,0 +1,98 @@
+/*
+ * getrusage, getrlimit and setrlimit. Of the usage counts only the
+ * page faults, and the pages fault-around mapped without one, are
+ * kept; the rest read as zero. Of the limits only the stack's can be
+ * changed.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/time.h>
+#include <kern/resource.h>
+#include <limits.h>
+#include <lib.h>
+#include <proc.h>
+#include <current.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+#include "opt-dumbvm.h"
+
+/*
+ * Children are not counted: nothing is collected from them when
+ * they exit, so RUSAGE_CHILDREN reads all zero.
+ */
+int
+sys_getrusage(int who, userptr_t usage)
+{
+	struct rusage ru;
+
+	if (who != RUSAGE_SELF && who != RUSAGE_CHILDREN) {
+		return EINVAL;
+	}
+
+	bzero(&ru, sizeof(ru));
+	if (who == RUSAGE_SELF) {
+		ru.ru_minflt = curproc->p_minflt;
+		ru.ru_majflt = curproc->p_majflt;
+		ru.ru_prefault = curproc->p_prefault;
+	}
+	return copyout(&ru, usage, sizeof(ru));
+}
+
+int
+sys_getrlimit(int resource, userptr_t rlp)
+{
+	struct rlimit rl;
+
+	if (resource < 0 || resource >= __RLIMIT_NUM) {
+		return EINVAL;
+	}
+
+	rl.rlim_cur = rl.rlim_max = RLIM_INFINITY;
+	if (resource == RLIMIT_NOFILE) {
+		rl.rlim_cur = rl.rlim_max = OPEN_MAX;
+	}
+#if !OPT_DUMBVM
+	if (resource == RLIMIT_STACK) {
+		rl.rlim_cur = (rlim_t)proc_getas()->as_stackmax * PAGE_SIZE;
+		rl.rlim_max = (rlim_t)VM_STACKMAX * PAGE_SIZE;
+	}
+#endif
+	return copyout(&rl, rlp, sizeof(rl));
+}
+
+/*
+ * The soft stack limit can be set anywhere from a page up to the
+ * hard limit, which stays put. Lowering it below what the stack has
+ * already grown to just stops it growing further.
+ */
+int
+sys_setrlimit(int resource, const_userptr_t rlp)
+{
+	struct rlimit rl;
+	int result;
+
+	if (resource < 0 || resource >= __RLIMIT_NUM) {
+		return EINVAL;
+	}
+	result = copyin(rlp, &rl, sizeof(rl));
+	if (result) {
+		return result;
+	}
+
+#if !OPT_DUMBVM
+	if (resource == RLIMIT_STACK) {
+		if (rl.rlim_max != (rlim_t)VM_STACKMAX * PAGE_SIZE) {
+			return EPERM;
+		}
+		if (rl.rlim_cur < PAGE_SIZE || rl.rlim_cur > rl.rlim_max) {
+			return EINVAL;
+		}
+		proc_getas()->as_stackmax =
+			((size_t)rl.rlim_cur + PAGE_SIZE - 1) / PAGE_SIZE;
+		return 0;
+	}
+#endif
+	return EPERM;
+}
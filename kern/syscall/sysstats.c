@@ -0,0 +1,246 @@
+/*
+ * Per-syscall counters and latency histograms; see <sysstats.h>.
+ *
+ * syscall() records every call into the current cpu's stats with
+ * interrupts off, so the counters need no lock and no cpu ever
+ * writes another cpu's cache lines. Readers walk every cpu's copy
+ * without locking and add them up; a reader racing with a syscall
+ * may see a count one behind, which is fine for statistics.
+ */
+
+#include <types.h>
+#include <kern/syscall.h>
+#include <lib.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <clock.h>
+#include <cpu.h>
+#include <current.h>
+#include <sysstats.h>
+
+/* stats of every cpu, so readers can find them all */
+struct sysstats_node {
+	struct sysstats *sn_stats;
+	struct sysstats_node *sn_next;
+};
+static struct sysstats_node *sysstats_all;
+static struct spinlock sysstats_lock = SPINLOCK_INITIALIZER;
+
+static const char *const sysstats_names[SYSSTATS_NCALLS] = {
+	[SYS_fork] = "fork",
+	[SYS_execv] = "execv",
+	[SYS__exit] = "_exit",
+	[SYS_waitpid] = "waitpid",
+	[SYS_getpid] = "getpid",
+	[SYS_sbrk] = "sbrk",
+	[SYS_mmap] = "mmap",
+	[SYS_munmap] = "munmap",
+	[SYS_msync] = "msync",
+	[SYS_open] = "open",
+	[SYS_pipe] = "pipe",
+	[SYS_dup] = "dup",
+	[SYS_dup2] = "dup2",
+	[SYS_close] = "close",
+	[SYS_read] = "read",
+	[SYS_pread] = "pread",
+	[SYS_readv] = "readv",
+	[SYS_preadv] = "preadv",
+	[SYS_getdirentry] = "getdirentry",
+	[SYS_write] = "write",
+	[SYS_pwrite] = "pwrite",
+	[SYS_writev] = "writev",
+	[SYS_pwritev] = "pwritev",
+	[SYS_lseek] = "lseek",
+	[SYS_fsync] = "fsync",
+	[SYS_select] = "select",
+	[SYS_poll] = "poll",
+	[SYS_getrusage] = "getrusage",
+	[SYS_getrlimit] = "getrlimit",
+	[SYS_setrlimit] = "setrlimit",
+	[SYS_remove] = "remove",
+	[SYS_mkdir] = "mkdir",
+	[SYS_rmdir] = "rmdir",
+	[SYS_rename] = "rename",
+	[SYS_chdir] = "chdir",
+	[SYS___getcwd] = "__getcwd",
+	[SYS_stat] = "stat",
+	[SYS_fstat] = "fstat",
+	[SYS_lstat] = "lstat",
+	[SYS___time] = "__time",
+	[SYS_nanosleep] = "nanosleep",
+	[SYS_sync] = "sync",
+	[SYS_reboot] = "reboot",
+	[SYS_ioring_setup] = "ioring_setup",
+	[SYS_ioring_enter] = "ioring_enter",
+	[SYS_copy_file_range] = "copy_file_range",
+};
+
+struct sysstats *
+sysstats_create(void)
+{
+	struct sysstats *ss;
+	struct sysstats_node *sn;
+
+	ss = kmalloc(sizeof(*ss));
+	if (ss == NULL) {
+		return NULL;
+	}
+	sn = kmalloc(sizeof(*sn));
+	if (sn == NULL) {
+		kfree(ss);
+		return NULL;
+	}
+	bzero(ss, sizeof(*ss));
+	sn->sn_stats = ss;
+
+	spinlock_acquire(&sysstats_lock);
+	sn->sn_next = sysstats_all;
+	sysstats_all = sn;
+	spinlock_release(&sysstats_lock);
+
+	return ss;
+}
+
+/*
+ * Which histogram bucket a latency of USEC microseconds falls in.
+ */
+static
+unsigned
+sysstats_bucket(uint32_t usec)
+{
+	unsigned b = 0;
+
+	while (usec >= 2 && b < SYSSTATS_NBUCKETS - 1) {
+		usec >>= 1;
+		b++;
+	}
+	return b;
+}
+
+void
+sysstats_record(int callno, const struct timespec *start, int err)
+{
+	struct timespec now, delta;
+	struct sysstats_call *sc;
+	uint32_t usec;
+	int spl;
+
+	if (callno < 0 || callno >= SYSSTATS_NCALLS) {
+		return;
+	}
+
+	gettime(&now);
+	timespec_sub(&now, start, &delta);
+	if (delta.tv_sec >= 4000) {
+		/* would overflow; it goes in the last bucket anyway */
+		usec = 0xffffffff;
+	}
+	else {
+		usec = delta.tv_sec * 1000000 + delta.tv_nsec / 1000;
+	}
+
+	/* stay on this cpu while touching its counters */
+	spl = splhigh();
+	if (curcpu->c_sysstats != NULL) {
+		sc = &curcpu->c_sysstats->ss_calls[callno];
+		sc->sc_count++;
+		if (err) {
+			sc->sc_errors++;
+		}
+		sc->sc_hist[sysstats_bucket(usec)]++;
+	}
+	splx(spl);
+}
+
+/*
+ * Add up every cpu's counters for CALLNO.
+ */
+static
+void
+sysstats_sum(int callno, struct sysstats_call *ret)
+{
+	struct sysstats_node *sn;
+	const struct sysstats_call *sc;
+	unsigned b;
+
+	bzero(ret, sizeof(*ret));
+
+	/* nodes are only ever pushed on the front, so no lock needed */
+	for (sn = sysstats_all; sn != NULL; sn = sn->sn_next) {
+		sc = &sn->sn_stats->ss_calls[callno];
+		ret->sc_count += sc->sc_count;
+		ret->sc_errors += sc->sc_errors;
+		for (b = 0; b < SYSSTATS_NBUCKETS; b++) {
+			ret->sc_hist[b] += sc->sc_hist[b];
+		}
+	}
+}
+
+size_t
+sysstats_format(char *buf, size_t len)
+{
+	struct sysstats_call sc;
+	char namebuf[16];
+	const char *name;
+	unsigned b, last;
+	size_t pos = 0;
+	int callno;
+
+	SYSSTATS_PRINTF(buf, len, pos,
+			"%-16s %10s %8s  latency: calls per log2(usec) "
+			"bucket, from <2us\n", "syscall", "calls", "errors");
+
+	for (callno = 0; callno < SYSSTATS_NCALLS; callno++) {
+		sysstats_sum(callno, &sc);
+		if (sc.sc_count == 0) {
+			continue;
+		}
+
+		name = sysstats_names[callno];
+		if (name == NULL) {
+			snprintf(namebuf, sizeof(namebuf), "#%d", callno);
+			name = namebuf;
+		}
+
+		/* leave off the empty buckets at the slow end */
+		last = 0;
+		for (b = 0; b < SYSSTATS_NBUCKETS; b++) {
+			if (sc.sc_hist[b] != 0) {
+				last = b;
+			}
+		}
+
+		SYSSTATS_PRINTF(buf, len, pos, "%-16s %10u %8u ",
+				name, sc.sc_count, sc.sc_errors);
+		for (b = 0; b <= last; b++) {
+			SYSSTATS_PRINTF(buf, len, pos, " %u", sc.sc_hist[b]);
+		}
+		SYSSTATS_PRINTF(buf, len, pos, "\n");
+	}
+
+	return pos;
+}
+
+void
+sysstats_print(void)
+{
+	char *buf;
+	size_t len, need;
+
+	len = 4096;
+	while (1) {
+		buf = kmalloc(len);
+		if (buf == NULL) {
+			kprintf("sysstats: out of memory\n");
+			return;
+		}
+		need = sysstats_format(buf, len);
+		if (need < len) {
+			break;
+		}
+		kfree(buf);
+		len = need + 1;
+	}
+	kprintf("%s", buf);
+	kfree(buf);
+}
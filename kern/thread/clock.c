@@ -32,6 +32,7 @@
 #include <cpu.h>
 #include <wchan.h>
 #include <clock.h>
+#include <poll.h>
 #include <thread.h>
 #include <current.h>
 
@@ -97,6 +98,7 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	poll_hardclock();
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
@@ -50,6 +50,9 @@
 #include <addrspace.h>
 #include <mainbus.h>
 #include <vnode.h>
+#include <sysstats.h>
+#include <vm.h>
+#include "opt-unsw.h"
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
@@ -179,6 +182,10 @@ cpu_create(unsigned hardware_number)
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
 	c->c_spinlocks = 0;
+	c->c_sysstats = sysstats_create();
+	if (c->c_sysstats == NULL) {
+		panic("cpu_create: Out of memory\n");
+	}
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -644,7 +651,21 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		next = threadlist_remhead(&curcpu->c_runqueue);
 		if (next == NULL) {
 			spinlock_release(&curcpu->c_runqueue_lock);
+#if OPT_UNSW
+			/*
+			 * Zero a page for later rather than sleep, a
+			 * page at a time, taking any interrupts that
+			 * came in meanwhile between pages.
+			 */
+			if (frame_zero_idle()) {
+				cpu_irqonoff();
+			}
+			else {
+				cpu_idle();
+			}
+#else
 			cpu_idle();
+#endif
 			spinlock_acquire(&curcpu->c_runqueue_lock);
 		}
 	} while (next == NULL);
@@ -1160,6 +1181,28 @@ ipi_tlbshootdown(struct cpu *target, const struct tlbshootdown *mapping)
 	spinlock_release(&target->c_ipi_lock);
 }
 
+/*
+ * Send a TLB shootdown IPI to the CPUs in the bitmask CPUS, except
+ * the current one.
+ */
+unsigned
+ipi_tlbshootdown_cpus(uint32_t cpus, const struct tlbshootdown *mapping)
+{
+	unsigned i, n;
+	struct cpu *c;
+
+	n = 0;
+	for (i=0; i < cpuarray_num(&allcpus); i++) {
+		c = cpuarray_get(&allcpus, i);
+		if (c != curcpu->c_self &&
+		    (cpus & ((uint32_t)1 << c->c_number)) != 0) {
+			ipi_tlbshootdown(c, mapping);
+			n++;
+		}
+	}
+	return n;
+}
+
 /*
  * Handle an incoming interprocessor interrupt.
  */
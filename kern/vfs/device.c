@@ -237,15 +237,15 @@ null_fsync(struct vnode *v)
 }
 
 /*
- * For mmap. If you want this to do anything, you have to write it
- * yourself. Some devices may not make sense to map. Others do.
+ * For mmap. Some devices may not make sense to map; others do, but
+ * none of ours can be mapped yet.
  */
 static
 int
 dev_mmap(struct vnode *v  /* add stuff as needed */)
 {
 	(void)v;
-	return ENOSYS;
+	return ENODEV;
 }
 
 /*
@@ -289,6 +289,22 @@ dev_namefile(struct vnode *v, struct uio *uio)
 	return 0;
 }
 
+/*
+ * Poll. Devices that can make the caller wait say when they are
+ * ready; the rest (disks, null, random) never block.
+ */
+static
+int
+dev_poll(struct vnode *v, int events, int *revents)
+{
+	struct device *d = v->vn_data;
+
+	if (d->d_ops->devop_poll == NULL) {
+		return vopdefault_poll(v, events, revents);
+	}
+	return DEVOP_POLL(d, events, revents);
+}
+
 /*
  * Name lookup.
  *
@@ -339,6 +355,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	.vop_mmap = dev_mmap,
 	.vop_truncate = dev_truncate,
 	.vop_namefile = dev_namefile,
+	.vop_poll = dev_poll,
 	.vop_creat = vopfail_creat_notdir,
 	.vop_symlink = vopfail_symlink_notdir,
 	.vop_mkdir = vopfail_mkdir_notdir,
@@ -0,0 +1,455 @@
+/*
+ * Anonymous pipes.
+ *
+ * The data lives in a ring of PIPE_PAGES whole pages. rpos and wpos
+ * are free-running byte counts, so wpos - rpos is the amount
+ * buffered and the byte at position p is at offset p % PAGE_SIZE in
+ * page (p / PAGE_SIZE) % PIPE_PAGES. A transfer is done in pieces
+ * that never cross a page boundary, so a large write costs one
+ * uiomove per page rather than one per byte.
+ *
+ * Each end is its own vnode, so the pipe can tell from VOP_RECLAIM
+ * when all readers or all writers have gone. Readers and writers
+ * sleep on the pipe's own condition variables; nothing global is
+ * held while they wait.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <limits.h>
+#include <stat.h>
+#include <lib.h>
+#include <uio.h>
+#include <synch.h>
+#include <vm.h>
+#include <vnode.h>
+#include <poll.h>
+#include <pipe.h>
+
+/* buffer size in pages */
+#define PIPE_PAGES	16
+#define PIPE_SIZE	(PIPE_PAGES * PAGE_SIZE)
+
+struct pipe;
+
+/*
+ * One end of a pipe.
+ */
+struct pipe_end {
+	struct vnode pe_vnode;
+	struct pipe *pe_pipe;
+	bool pe_iswrite;
+};
+
+struct pipe {
+	struct lock *p_lock;		/* protects everything below */
+	struct cv *p_readcv;		/* readers wait here for data */
+	struct cv *p_writecv;		/* writers wait here for space */
+	char *p_pages[PIPE_PAGES];	/* the ring */
+	unsigned p_rpos;		/* bytes read so far */
+	unsigned p_wpos;		/* bytes written so far */
+	bool p_readopen;		/* read end still exists */
+	bool p_writeopen;		/* write end still exists */
+	struct pipe_end p_read;
+	struct pipe_end p_write;
+};
+
+static
+void
+pipe_destroy(struct pipe *p)
+{
+	unsigned i;
+
+	for (i=0; i<PIPE_PAGES; i++) {
+		if (p->p_pages[i] != NULL) {
+			kfree(p->p_pages[i]);
+		}
+	}
+	if (p->p_writecv != NULL) {
+		cv_destroy(p->p_writecv);
+	}
+	if (p->p_readcv != NULL) {
+		cv_destroy(p->p_readcv);
+	}
+	if (p->p_lock != NULL) {
+		lock_destroy(p->p_lock);
+	}
+	kfree(p);
+}
+
+/*
+ * Where byte position POS lives, and how much of its page is left.
+ */
+static
+char *
+pipe_addr(struct pipe *p, unsigned pos, size_t *pageleft)
+{
+	*pageleft = PAGE_SIZE - pos % PAGE_SIZE;
+	return p->p_pages[(pos / PAGE_SIZE) % PIPE_PAGES] + pos % PAGE_SIZE;
+}
+
+////////////////////////////////////////////////////////////
+// vnode ops
+
+static
+int
+pipe_eachopen(struct vnode *v, int openflags)
+{
+	/* pipes are never opened by name */
+	(void)v;
+	(void)openflags;
+	return EINVAL;
+}
+
+/*
+ * The last reference to one end went away. Let the other end know;
+ * the second end to go takes the pipe with it.
+ */
+static
+int
+pipe_reclaim(struct vnode *v)
+{
+	struct pipe_end *pe = v->vn_data;
+	struct pipe *p = pe->pe_pipe;
+	bool last;
+
+	lock_acquire(p->p_lock);
+	if (pe->pe_iswrite) {
+		p->p_writeopen = false;
+		cv_broadcast(p->p_readcv, p->p_lock);
+	}
+	else {
+		p->p_readopen = false;
+		cv_broadcast(p->p_writecv, p->p_lock);
+	}
+	last = !p->p_readopen && !p->p_writeopen;
+	/* once the lock is dropped the other end may free the pipe */
+	vnode_cleanup(v);
+	lock_release(p->p_lock);
+
+	if (last) {
+		pipe_destroy(p);
+	}
+	else {
+		/* readers see EOF, writers see EPIPE */
+		poll_wakeup();
+	}
+	return 0;
+}
+
+/*
+ * Read whatever is buffered, waiting only if there is nothing at all.
+ */
+static
+int
+pipe_read(struct vnode *v, struct uio *uio)
+{
+	struct pipe_end *pe = v->vn_data;
+	struct pipe *p = pe->pe_pipe;
+	size_t avail, pageleft, len;
+	bool wasfull;
+	char *addr;
+	int result = 0;
+
+	if (pe->pe_iswrite) {
+		return EBADF;
+	}
+
+	lock_acquire(p->p_lock);
+	while (p->p_wpos == p->p_rpos && p->p_writeopen) {
+		cv_wait(p->p_readcv, p->p_lock);
+	}
+
+	wasfull = p->p_wpos - p->p_rpos == PIPE_SIZE;
+	while (uio->uio_resid > 0 && p->p_wpos != p->p_rpos) {
+		avail = p->p_wpos - p->p_rpos;
+		addr = pipe_addr(p, p->p_rpos, &pageleft);
+		len = uio->uio_resid;
+		if (len > avail) {
+			len = avail;
+		}
+		if (len > pageleft) {
+			len = pageleft;
+		}
+		result = uiomove(addr, len, uio);
+		if (result) {
+			break;
+		}
+		p->p_rpos += len;
+	}
+
+	/* uio_offset means nothing for a pipe */
+	uio->uio_offset = 0;
+
+	if (p->p_wpos - p->p_rpos < PIPE_SIZE) {
+		cv_broadcast(p->p_writecv, p->p_lock);
+	}
+	lock_release(p->p_lock);
+
+	if (wasfull) {
+		poll_wakeup();
+	}
+	return result;
+}
+
+/*
+ * Write all of it, waiting for room as needed. Writes of up to
+ * PIPE_BUF bytes wait until they fit in one go, so they are never
+ * interleaved with other writers' data.
+ */
+static
+int
+pipe_write(struct vnode *v, struct uio *uio)
+{
+	struct pipe_end *pe = v->vn_data;
+	struct pipe *p = pe->pe_pipe;
+	size_t startresid = uio->uio_resid;
+	size_t space, pageleft, len, need;
+	bool wasempty;
+	char *addr;
+	int result = 0;
+
+	if (!pe->pe_iswrite) {
+		return EBADF;
+	}
+
+	need = uio->uio_resid <= PIPE_BUF ? uio->uio_resid : 1;
+
+	lock_acquire(p->p_lock);
+	while (uio->uio_resid > 0) {
+		while (PIPE_SIZE - (p->p_wpos - p->p_rpos) < need &&
+		       p->p_readopen) {
+			cv_wait(p->p_writecv, p->p_lock);
+		}
+		if (!p->p_readopen) {
+			/* report a short write if any of it got through */
+			result = uio->uio_resid == startresid ? EPIPE : 0;
+			break;
+		}
+
+		wasempty = p->p_wpos == p->p_rpos;
+		space = PIPE_SIZE - (p->p_wpos - p->p_rpos);
+		while (uio->uio_resid > 0 && space > 0) {
+			addr = pipe_addr(p, p->p_wpos, &pageleft);
+			len = uio->uio_resid;
+			if (len > space) {
+				len = space;
+			}
+			if (len > pageleft) {
+				len = pageleft;
+			}
+			result = uiomove(addr, len, uio);
+			if (result) {
+				break;
+			}
+			p->p_wpos += len;
+			space -= len;
+		}
+
+		cv_broadcast(p->p_readcv, p->p_lock);
+		if (wasempty) {
+			poll_wakeup();
+		}
+		if (result) {
+			break;
+		}
+		need = 1;
+	}
+	uio->uio_offset = 0;
+	lock_release(p->p_lock);
+
+	return result;
+}
+
+static
+int
+pipe_ioctl(struct vnode *v, int op, userptr_t data)
+{
+	(void)v;
+	(void)op;
+	(void)data;
+	return EINVAL;
+}
+
+static
+int
+pipe_stat(struct vnode *v, struct stat *st)
+{
+	struct pipe_end *pe = v->vn_data;
+	struct pipe *p = pe->pe_pipe;
+
+	bzero(st, sizeof(*st));
+	lock_acquire(p->p_lock);
+	st->st_size = p->p_wpos - p->p_rpos;
+	lock_release(p->p_lock);
+	st->st_mode = S_IFIFO | 0600;
+	st->st_nlink = 0;
+	st->st_blksize = PAGE_SIZE;
+	return 0;
+}
+
+static
+int
+pipe_gettype(struct vnode *v, mode_t *ret)
+{
+	(void)v;
+	*ret = S_IFIFO;
+	return 0;
+}
+
+static
+bool
+pipe_isseekable(struct vnode *v)
+{
+	(void)v;
+	return false;
+}
+
+static
+int
+pipe_fsync(struct vnode *v)
+{
+	(void)v;
+	return 0;
+}
+
+static
+int
+pipe_truncate(struct vnode *v, off_t len)
+{
+	(void)v;
+	(void)len;
+	return EINVAL;
+}
+
+static
+int
+pipe_poll(struct vnode *v, int events, int *revents)
+{
+	struct pipe_end *pe = v->vn_data;
+	struct pipe *p = pe->pe_pipe;
+	unsigned used;
+
+	*revents = 0;
+	lock_acquire(p->p_lock);
+	used = p->p_wpos - p->p_rpos;
+	if (pe->pe_iswrite) {
+		if (!p->p_readopen) {
+			*revents |= POLLERR;
+		}
+		else if (PIPE_SIZE - used >= PIPE_BUF) {
+			*revents |= events & POLLOUT;
+		}
+	}
+	else {
+		if (used > 0) {
+			*revents |= events & POLLIN;
+		}
+		if (!p->p_writeopen) {
+			*revents |= POLLHUP;
+		}
+	}
+	lock_release(p->p_lock);
+	return 0;
+}
+
+static const struct vnode_ops pipe_vnode_ops = {
+	.vop_magic = VOP_MAGIC,
+
+	.vop_eachopen = pipe_eachopen,
+	.vop_reclaim = pipe_reclaim,
+
+	.vop_read = pipe_read,
+	.vop_readlink = vopfail_uio_inval,
+	.vop_getdirentry = vopfail_uio_notdir,
+	.vop_write = pipe_write,
+	.vop_ioctl = pipe_ioctl,
+	.vop_stat = pipe_stat,
+	.vop_gettype = pipe_gettype,
+	.vop_isseekable = pipe_isseekable,
+	.vop_fsync = pipe_fsync,
+	.vop_mmap = vopfail_mmap_perm,
+	.vop_truncate = pipe_truncate,
+	.vop_namefile = vopfail_uio_notdir,
+	.vop_poll = pipe_poll,
+
+	.vop_creat = vopfail_creat_notdir,
+	.vop_symlink = vopfail_symlink_notdir,
+	.vop_mkdir = vopfail_mkdir_notdir,
+	.vop_link = vopfail_link_notdir,
+	.vop_remove = vopfail_string_notdir,
+	.vop_rmdir = vopfail_string_notdir,
+	.vop_rename = vopfail_rename_notdir,
+	.vop_lookup = vopfail_lookup_notdir,
+	.vop_lookparent = vopfail_lookparent_notdir,
+};
+
+////////////////////////////////////////////////////////////
+// creation
+
+static
+void
+pipe_end_init(struct pipe *p, struct pipe_end *pe, bool iswrite)
+{
+	int result;
+
+	pe->pe_pipe = p;
+	pe->pe_iswrite = iswrite;
+	/* pipes don't belong to any filesystem */
+	result = vnode_init(&pe->pe_vnode, &pipe_vnode_ops, NULL, pe);
+	/* vnode_init doesn't actually fail */
+	KASSERT(result == 0);
+}
+
+int
+pipe_create(struct vnode **readvn, struct vnode **writevn)
+{
+	struct pipe *p;
+	unsigned i;
+
+	p = kmalloc(sizeof(*p));
+	if (p == NULL) {
+		return ENOMEM;
+	}
+	p->p_lock = NULL;
+	p->p_readcv = NULL;
+	p->p_writecv = NULL;
+	for (i=0; i<PIPE_PAGES; i++) {
+		p->p_pages[i] = NULL;
+	}
+
+	p->p_lock = lock_create("pipe");
+	if (p->p_lock == NULL) {
+		goto fail;
+	}
+	p->p_readcv = cv_create("pipe read");
+	if (p->p_readcv == NULL) {
+		goto fail;
+	}
+	p->p_writecv = cv_create("pipe write");
+	if (p->p_writecv == NULL) {
+		goto fail;
+	}
+	for (i=0; i<PIPE_PAGES; i++) {
+		p->p_pages[i] = kmalloc(PAGE_SIZE);
+		if (p->p_pages[i] == NULL) {
+			goto fail;
+		}
+	}
+
+	p->p_rpos = 0;
+	p->p_wpos = 0;
+	p->p_readopen = true;
+	p->p_writeopen = true;
+	pipe_end_init(p, &p->p_read, false);
+	pipe_end_init(p, &p->p_write, true);
+
+	*readvn = &p->p_read.pe_vnode;
+	*writevn = &p->p_write.pe_vnode;
+	return 0;
+
+ fail:
+	pipe_destroy(p);
+	return ENOMEM;
+}
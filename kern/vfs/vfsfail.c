@@ -29,6 +29,7 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/poll.h>
 #include <vnode.h>
 
 /*
@@ -262,3 +263,18 @@ vopfail_lookparent_notdir(struct vnode *vn, char *path, struct vnode **result,
 	return ENOTDIR;
 }
 
+////////////////////////////////////////////////////////////
+// poll
+
+/*
+ * Not a failure, but shared the same way: regular files,
+ * directories and most devices can always be read and written
+ * without waiting.
+ */
+int
+vopdefault_poll(struct vnode *vn, int events, int *revents)
+{
+	(void)vn;
+	*revents = events & (POLLIN | POLLOUT);
+	return 0;
+}
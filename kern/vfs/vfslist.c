@@ -114,6 +114,7 @@ vfs_bootstrap(void)
 
 	devnull_create();
 	semfs_bootstrap();
+	statsfs_bootstrap();
 }
 
 /*
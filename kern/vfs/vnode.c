@@ -36,6 +36,9 @@
 #include <synch.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <vm.h>
+#include <pagecache.h>
+#include "opt-dumbvm.h"
 
 /*
  * Initialize an abstract vnode.
@@ -52,6 +55,7 @@ vnode_init(struct vnode *vn, const struct vnode_ops *ops,
 	spinlock_init(&vn->vn_countlock);
 	vn->vn_fs = fs;
 	vn->vn_data = fsdata;
+	vn->vn_pages = NULL;
 	return 0;
 }
 
@@ -63,6 +67,9 @@ vnode_cleanup(struct vnode *vn)
 {
 	KASSERT(vn->vn_refcount == 1);
 
+#if !OPT_DUMBVM
+	pagecache_purge(vn, true);
+#endif
 	spinlock_cleanup(&vn->vn_countlock);
 
 	vn->vn_ops = NULL;
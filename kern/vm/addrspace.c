@@ -29,49 +29,143 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/mman.h>
 #include <lib.h>
 #include <addrspace.h>
 #include <vm.h>
+#include <pagetable.h>
 #include <proc.h>
+#include <synch.h>
+#include <swap.h>
+#include <vnode.h>
 
 /*
  * Note! If OPT_DUMBVM is set, as is the case until you start the VM
  * assignment, this file is not compiled or linked or in any way
  * used. The cheesy hack versions in dumbvm.c are used instead.
+ *
+ * An address space is a list of regions plus a page table. Nothing
+ * is allocated for a region when it is defined: vm_fault allocates
+ * each page the first time it is touched, and zeroes it or reads it
+ * from the file backing the region (as_map_file).
  */
 
 struct addrspace *
 as_create(void)
 {
 	struct addrspace *as;
+	unsigned i;
 
 	as = kmalloc(sizeof(struct addrspace));
 	if (as == NULL) {
 		return NULL;
 	}
 
-	/*
-	 * Initialize as needed.
-	 */
+	as->as_pt = pt_create(as);
+	if (as->as_pt == NULL) {
+		kfree(as);
+		return NULL;
+	}
+	as->as_regions = NULL;
+	as->as_heap = NULL;
+	as->as_heapend = 0;
+	as->as_stack = NULL;
+	as->as_stackmax = VM_STACKPAGES;
+	as->as_paging = 0;
+	for (i=0; i<MAXCPUS; i++) {
+		as->as_asid[i] = 0;
+	}
 
 	return as;
 }
 
+/*
+ * Add a region. Regions may not overlap.
+ */
+static
+int
+as_add_region(struct addrspace *as, vaddr_t vaddr, size_t npages, bool write)
+{
+	struct region *reg;
+	vaddr_t top = vaddr + npages * PAGE_SIZE;
+
+	if (top < vaddr || top > USERSPACETOP) {
+		return EFAULT;
+	}
+	for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+		if (vaddr < reg->rg_base + reg->rg_npages * PAGE_SIZE &&
+		    reg->rg_base < top) {
+			return EINVAL;
+		}
+	}
+
+	reg = kmalloc(sizeof(*reg));
+	if (reg == NULL) {
+		return ENOMEM;
+	}
+	reg->rg_base = vaddr;
+	reg->rg_npages = npages;
+	reg->rg_write = write;
+	reg->rg_vnode = NULL;
+	reg->rg_filebase = 0;
+	reg->rg_fileoff = 0;
+	reg->rg_filesz = 0;
+	reg->rg_mmap = 0;
+	reg->rg_next = as->as_regions;
+	as->as_regions = reg;
+	return 0;
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *newas;
+	struct region *reg;
+	int result;
 
 	newas = as_create();
 	if (newas==NULL) {
 		return ENOMEM;
 	}
 
+	for (reg = old->as_regions; reg != NULL; reg = reg->rg_next) {
+		result = as_add_region(newas, reg->rg_base, reg->rg_npages,
+				       reg->rg_write);
+		if (result) {
+			as_destroy(newas);
+			return result;
+		}
+		/* the new region went on the front */
+		if (reg->rg_vnode != NULL) {
+			VOP_INCREF(reg->rg_vnode);
+			newas->as_regions->rg_vnode = reg->rg_vnode;
+			newas->as_regions->rg_filebase = reg->rg_filebase;
+			newas->as_regions->rg_fileoff = reg->rg_fileoff;
+			newas->as_regions->rg_filesz = reg->rg_filesz;
+			newas->as_regions->rg_mmap = reg->rg_mmap;
+		}
+		if (reg == old->as_heap) {
+			newas->as_heap = newas->as_regions;
+		}
+		if (reg == old->as_stack) {
+			newas->as_stack = newas->as_regions;
+		}
+	}
+	newas->as_heapend = old->as_heapend;
+	newas->as_stackmax = old->as_stackmax;
+
 	/*
-	 * Write this.
+	 * Writable pages are now copy-on-write in OLD too, even if
+	 * this failed part way, so its TLB entries must go.
 	 */
-
-	(void)old;
+	lock_acquire(vm_lock);
+	result = pt_copy(old->as_pt, newas->as_pt);
+	vm_tlbflush_as(old);
+	lock_release(vm_lock);
+	if (result) {
+		as_destroy(newas);
+		return result;
+	}
 
 	*ret = newas;
 	return 0;
@@ -80,10 +174,34 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 void
 as_destroy(struct addrspace *as)
 {
+	struct region *reg;
+
+	for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+		if (reg->rg_mmap == MAP_SHARED) {
+			/* nobody to report a failure to */
+			(void)vm_syncpages(as, reg, reg->rg_base,
+				reg->rg_base + reg->rg_npages * PAGE_SIZE,
+				false);
+		}
+	}
+
+	lock_acquire(vm_lock);
+	swap_wait(as);
+	pt_destroy(as->as_pt);
+	lock_release(vm_lock);
+
 	/*
-	 * Clean up as needed.
+	 * Only now let go of the files: the pageout thread relies on
+	 * a mapped page's file staying open (see pagecache_file).
 	 */
-
+	while (as->as_regions != NULL) {
+		reg = as->as_regions;
+		as->as_regions = reg->rg_next;
+		if (reg->rg_vnode != NULL) {
+			VOP_DECREF(reg->rg_vnode);
+		}
+		kfree(reg);
+	}
 	kfree(as);
 }
 
@@ -101,19 +219,14 @@ as_activate(void)
 		return;
 	}
 
-	/*
-	 * Write this.
-	 */
+	vm_tlbactivate(as);
 }
 
 void
 as_deactivate(void)
 {
-	/*
-	 * Write this. For many designs it won't need to actually do
-	 * anything. See proc.c for an explanation of why it (might)
-	 * be needed.
-	 */
+	/* the address space is about to go; stop refilling from it */
+	vm_tlbactivate(NULL);
 }
 
 /*
@@ -122,34 +235,34 @@ as_deactivate(void)
  * VADDR+MEMSIZE.
  *
  * The READABLE, WRITEABLE, and EXECUTABLE flags are set if read,
- * write, or execute permission should be set on the segment. At the
- * moment, these are ignored. When you write the VM system, you may
- * want to implement them.
+ * write, or execute permission should be set on the segment. Only
+ * WRITEABLE is enforced; the MIPS TLB has no way to refuse reads or
+ * instruction fetches from a mapped page.
  */
 int
 as_define_region(struct addrspace *as, vaddr_t vaddr, size_t memsize,
 		 int readable, int writeable, int executable)
 {
-	/*
-	 * Write this.
-	 */
+	size_t npages;
 
-	(void)as;
-	(void)vaddr;
-	(void)memsize;
 	(void)readable;
-	(void)writeable;
 	(void)executable;
-	return ENOSYS;
+
+	/* Align the region. First, the base... */
+	memsize += vaddr & ~(vaddr_t)PAGE_FRAME;
+	vaddr &= PAGE_FRAME;
+
+	/* ...and now the length. */
+	memsize = (memsize + PAGE_SIZE - 1) & PAGE_FRAME;
+	npages = memsize / PAGE_SIZE;
+
+	return as_add_region(as, vaddr, npages, writeable != 0);
 }
 
 int
 as_prepare_load(struct addrspace *as)
 {
-	/*
-	 * Write this.
-	 */
-
+	/* nothing to do; the segments are paged in as they are touched */
 	(void)as;
 	return 0;
 }
@@ -157,22 +270,38 @@ as_prepare_load(struct addrspace *as)
 int
 as_complete_load(struct addrspace *as)
 {
-	/*
-	 * Write this.
-	 */
+	struct region *reg;
+	vaddr_t top, heapbase;
+	int result;
 
-	(void)as;
+	/* the heap starts out empty, just above the highest segment */
+	heapbase = 0;
+	for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+		top = reg->rg_base + reg->rg_npages * PAGE_SIZE;
+		if (top > heapbase) {
+			heapbase = top;
+		}
+	}
+	result = as_add_region(as, heapbase, 0, true);
+	if (result) {
+		return result;
+	}
+	as->as_heap = as->as_regions;
+	as->as_heapend = heapbase;
 	return 0;
 }
 
 int
 as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 {
-	/*
-	 * Write this.
-	 */
+	int result;
 
-	(void)as;
+	/* one page to start with; see as_grow_stack */
+	result = as_add_region(as, USERSTACK - PAGE_SIZE, 1, true);
+	if (result) {
+		return result;
+	}
+	as->as_stack = as->as_regions;
 
 	/* Initial user-level stack pointer */
 	*stackptr = USERSTACK;
@@ -180,3 +309,307 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+struct region *
+as_find_region(struct addrspace *as, vaddr_t vaddr)
+{
+	struct region *reg;
+
+	for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+		if (vaddr >= reg->rg_base &&
+		    vaddr - reg->rg_base < reg->rg_npages * PAGE_SIZE) {
+			return reg;
+		}
+	}
+	return NULL;
+}
+
+struct region *
+as_grow_stack(struct addrspace *as, vaddr_t vaddr)
+{
+	struct region *stack = as->as_stack;
+	struct region *reg;
+	vaddr_t base;
+
+	if (stack == NULL || vaddr >= stack->rg_base ||
+	    vaddr < USERSTACK - as->as_stackmax * PAGE_SIZE) {
+		return NULL;
+	}
+	base = vaddr & PAGE_FRAME;
+
+	/* not into anything mapped below it */
+	for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+		if (reg != stack && reg->rg_base < stack->rg_base &&
+		    base < reg->rg_base + reg->rg_npages * PAGE_SIZE) {
+			return NULL;
+		}
+	}
+
+	/* the new pages are allocated as they are touched */
+	stack->rg_npages += (stack->rg_base - base) / PAGE_SIZE;
+	stack->rg_base = base;
+	return stack;
+}
+
+int
+as_map_file(struct addrspace *as, vaddr_t vaddr, size_t filesize,
+	    struct vnode *vn, off_t offset)
+{
+	struct region *reg;
+
+	if (filesize == 0) {
+		/* all zero-fill, e.g. a BSS-only segment */
+		return 0;
+	}
+
+	reg = as_find_region(as, vaddr);
+	if (reg == NULL || reg->rg_vnode != NULL ||
+	    filesize > reg->rg_base + reg->rg_npages * PAGE_SIZE - vaddr) {
+		return EINVAL;
+	}
+
+	VOP_INCREF(vn);
+	reg->rg_vnode = vn;
+	reg->rg_filebase = vaddr;
+	reg->rg_fileoff = offset;
+	reg->rg_filesz = filesize;
+	return 0;
+}
+
+/*
+ * The highest address below the stack limit with NPAGES free pages above
+ * it, or 0 if there is none.
+ */
+static
+vaddr_t
+as_find_hole(struct addrspace *as, size_t npages)
+{
+	struct region *reg;
+	vaddr_t top = VM_MMAPTOP(as);
+	vaddr_t base;
+
+	while (npages * PAGE_SIZE <= top) {
+		base = top - npages * PAGE_SIZE;
+		for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+			if (base < reg->rg_base + reg->rg_npages * PAGE_SIZE &&
+			    reg->rg_base < top) {
+				break;
+			}
+		}
+		if (reg == NULL) {
+			return base;
+		}
+		/* try again below it */
+		top = reg->rg_base;
+	}
+	return 0;
+}
+
+int
+as_mmap(struct addrspace *as, vaddr_t *vaddr, size_t len, bool write,
+	int flags, struct vnode *vn, off_t offset, size_t filesz)
+{
+	struct region *reg;
+	size_t npages;
+	vaddr_t base;
+	int result;
+
+	if (len > USERSPACETOP) {
+		return ENOMEM;
+	}
+	npages = (len + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	if (flags & MAP_FIXED) {
+		base = *vaddr;
+	}
+	else {
+		base = as_find_hole(as, npages);
+		if (base == 0) {
+			return ENOMEM;
+		}
+	}
+	result = as_add_region(as, base, npages, write);
+	if (result) {
+		return result;
+	}
+
+	/* the new region went on the front */
+	reg = as->as_regions;
+	reg->rg_mmap = flags & MAP_TYPE;
+	reg->rg_vnode = vn;
+	reg->rg_filebase = base;
+	reg->rg_fileoff = offset;
+	reg->rg_filesz = filesz;
+	*vaddr = base;
+	return 0;
+}
+
+/*
+ * Cut the first pages of mmap region REG off, so that it starts at
+ * BASE, keeping the rest mapped where it was.
+ */
+static
+void
+as_trim_front(struct region *reg, vaddr_t base)
+{
+	size_t cut = base - reg->rg_base;
+
+	reg->rg_npages -= cut / PAGE_SIZE;
+	reg->rg_base = reg->rg_filebase = base;
+	reg->rg_fileoff += cut;
+	reg->rg_filesz = reg->rg_filesz > cut ? reg->rg_filesz - cut : 0;
+}
+
+/* Cut mmap region REG off at TOP. */
+static
+void
+as_trim_back(struct region *reg, vaddr_t top)
+{
+	reg->rg_npages = (top - reg->rg_base) / PAGE_SIZE;
+	if (reg->rg_filesz > top - reg->rg_base) {
+		reg->rg_filesz = top - reg->rg_base;
+	}
+}
+
+int
+as_munmap(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	struct region *reg, **regp, *upper;
+	vaddr_t end, top, start, stop;
+	int result;
+
+	if (len > USERSPACETOP) {
+		return EINVAL;
+	}
+	end = vaddr + ((len + PAGE_SIZE - 1) & PAGE_FRAME);
+	if (end < vaddr || end > USERSPACETOP) {
+		return EINVAL;
+	}
+
+	regp = &as->as_regions;
+	while ((reg = *regp) != NULL) {
+		top = reg->rg_base + reg->rg_npages * PAGE_SIZE;
+		if (reg->rg_mmap == 0 || top <= vaddr ||
+		    end <= reg->rg_base) {
+			/* other regions are left alone */
+			regp = &reg->rg_next;
+			continue;
+		}
+		start = vaddr > reg->rg_base ? vaddr : reg->rg_base;
+		stop = end < top ? end : top;
+
+		upper = NULL;
+		if (start > reg->rg_base && stop < top) {
+			/* a hole in the middle: what is above it splits off */
+			upper = kmalloc(sizeof(*upper));
+			if (upper == NULL) {
+				return ENOMEM;
+			}
+		}
+		result = vm_syncpages(as, reg, start, stop, true);
+		if (result) {
+			if (upper != NULL) {
+				kfree(upper);
+			}
+			return result;
+		}
+
+		if (upper != NULL) {
+			*upper = *reg;
+			VOP_INCREF(upper->rg_vnode);
+			as_trim_front(upper, stop);
+			as_trim_back(reg, start);
+			reg->rg_next = upper;
+			regp = &upper->rg_next;
+		}
+		else if (start > reg->rg_base) {
+			as_trim_back(reg, start);
+			regp = &reg->rg_next;
+		}
+		else if (stop < top) {
+			as_trim_front(reg, stop);
+			regp = &reg->rg_next;
+		}
+		else {
+			*regp = reg->rg_next;
+			VOP_DECREF(reg->rg_vnode);
+			kfree(reg);
+		}
+	}
+	return 0;
+}
+
+int
+as_msync(struct addrspace *as, vaddr_t vaddr, size_t len)
+{
+	struct region *reg;
+	vaddr_t end, top;
+	int result;
+
+	end = vaddr + len;
+	if (end < vaddr) {
+		return ENOMEM;
+	}
+	while (vaddr < end) {
+		reg = as_find_region(as, vaddr);
+		if (reg == NULL) {
+			return ENOMEM;
+		}
+		top = reg->rg_base + reg->rg_npages * PAGE_SIZE;
+		if (top > end) {
+			top = end;
+		}
+		if (reg->rg_mmap == MAP_SHARED) {
+			result = vm_syncpages(as, reg, vaddr, top, false);
+			if (result) {
+				return result;
+			}
+		}
+		vaddr = top;
+	}
+	return 0;
+}
+
+int
+as_sbrk(struct addrspace *as, intptr_t amount, vaddr_t *oldbreak)
+{
+	struct region *heap = as->as_heap;
+	struct region *reg;
+	vaddr_t newend, top, newtop;
+	int result;
+
+	if (heap == NULL) {
+		return ENOMEM;
+	}
+	newend = as->as_heapend + amount;
+	if (amount < 0) {
+		if (newend > as->as_heapend || newend < heap->rg_base) {
+			return EINVAL;
+		}
+	}
+	else if (newend < as->as_heapend || newend > USERSPACETOP) {
+		return ENOMEM;
+	}
+
+	top = heap->rg_base + heap->rg_npages * PAGE_SIZE;
+	newtop = (newend + PAGE_SIZE - 1) & PAGE_FRAME;
+	if (newtop > top) {
+		for (reg = as->as_regions; reg != NULL; reg = reg->rg_next) {
+			if (reg != heap && reg->rg_base < newtop &&
+			    top < reg->rg_base + reg->rg_npages * PAGE_SIZE) {
+				return ENOMEM;
+			}
+		}
+	}
+	else if (newtop < top) {
+		/* give the frames and swap slots back now */
+		result = vm_syncpages(as, heap, newtop, top, true);
+		if (result) {
+			return result;
+		}
+	}
+
+	heap->rg_npages = (newtop - heap->rg_base) / PAGE_SIZE;
+	*oldbreak = as->as_heapend;
+	as->as_heapend = newend;
+	return 0;
+}
@@ -0,0 +1,298 @@
+/*
+ * Per-vnode page cache; see pagecache.h.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <uio.h>
+#include <vnode.h>
+#include <vm.h>
+#include <pagecache.h>
+#include <sysstats.h>
+
+/* hash buckets per vnode */
+#define PC_BUCKETS 64
+
+#define PC_HASH(key) (((uint32_t)(key) / PAGE_SIZE) % PC_BUCKETS)
+
+struct pc_page {
+	struct vnode *pp_vn;
+	int pp_kind;
+	off_t pp_key;
+	paddr_t pp_pa;
+	struct pc_page *pp_next;
+};
+
+struct pagecache {
+	struct pc_page *pc_buckets[PC_BUCKETS];
+};
+
+/* protects every vnode's vn_pages, pagecache_frames and the counters */
+static struct spinlock pagecache_lock = SPINLOCK_INITIALIZER;
+
+/* the cached page each frame holds, if any, indexed by frame number */
+static struct pc_page **pagecache_frames;
+
+static unsigned pagecache_npages[2];	/* cached, all vnodes, by kind */
+static uint32_t pagecache_hits, pagecache_misses, pagecache_evicted;
+
+void
+pagecache_bootstrap(void)
+{
+	unsigned i, nframes;
+
+	nframes = ram_getsize() / PAGE_SIZE;
+	pagecache_frames = kmalloc(nframes * sizeof(*pagecache_frames));
+	if (pagecache_frames == NULL) {
+		panic("pagecache_bootstrap: out of memory\n");
+	}
+	for (i = 0; i < nframes; i++) {
+		pagecache_frames[i] = NULL;
+	}
+}
+
+/* PC's page of kind KIND at KEY, or NULL; call with pagecache_lock */
+static
+struct pc_page *
+pagecache_find(struct pagecache *pc, int kind, off_t key)
+{
+	struct pc_page *pp;
+
+	for (pp = pc->pc_buckets[PC_HASH(key)]; pp != NULL;
+	     pp = pp->pp_next) {
+		if (pp->pp_kind == kind && pp->pp_key == key) {
+			return pp;
+		}
+	}
+	return NULL;
+}
+
+paddr_t
+pagecache_get(struct vnode *vn, int kind, off_t key)
+{
+	struct pc_page *pp;
+	paddr_t pa = 0;
+
+	spinlock_acquire(&pagecache_lock);
+	if (vn->vn_pages != NULL) {
+		pp = pagecache_find(vn->vn_pages, kind, key);
+		if (pp != NULL) {
+			pa = pp->pp_pa;
+			frame_incref(pa);
+		}
+	}
+	if (pa != 0) {
+		pagecache_hits++;
+	}
+	else {
+		pagecache_misses++;
+	}
+	spinlock_release(&pagecache_lock);
+	return pa;
+}
+
+paddr_t
+pagecache_add(struct vnode *vn, int kind, off_t key, paddr_t pa)
+{
+	struct pagecache *pc, *newpc;
+	struct pc_page *pp, *newpp;
+	paddr_t ret = pa;
+	unsigned i;
+
+	/* no allocating under the spinlock */
+	newpp = kmalloc(sizeof(*newpp));
+	if (newpp == NULL) {
+		/* just don't cache it */
+		return pa;
+	}
+	newpp->pp_vn = vn;
+	newpp->pp_kind = kind;
+	newpp->pp_key = key;
+	newpp->pp_pa = pa;
+	newpc = NULL;
+	if (vn->vn_pages == NULL) {
+		newpc = kmalloc(sizeof(*newpc));
+		if (newpc == NULL) {
+			kfree(newpp);
+			return pa;
+		}
+		for (i = 0; i < PC_BUCKETS; i++) {
+			newpc->pc_buckets[i] = NULL;
+		}
+	}
+
+	spinlock_acquire(&pagecache_lock);
+	pc = vn->vn_pages;
+	if (pc == NULL && newpc != NULL) {
+		pc = vn->vn_pages = newpc;
+		newpc = NULL;
+	}
+	if (pc != NULL) {
+		pp = pagecache_find(pc, kind, key);
+		if (pp != NULL) {
+			/* another process read it in too */
+			ret = pp->pp_pa;
+			frame_incref(ret);
+		}
+		else {
+			frame_incref(pa);
+			newpp->pp_next = pc->pc_buckets[PC_HASH(key)];
+			pc->pc_buckets[PC_HASH(key)] = newpp;
+			pagecache_frames[pa / PAGE_SIZE] = newpp;
+			newpp = NULL;
+			pagecache_npages[kind]++;
+		}
+	}
+	spinlock_release(&pagecache_lock);
+
+	if (newpp != NULL) {
+		kfree(newpp);
+	}
+	if (newpc != NULL) {
+		kfree(newpc);
+	}
+	return ret;
+}
+
+void
+pagecache_purge(struct vnode *vn, bool all)
+{
+	struct pagecache *pc;
+	struct pc_page *pp, **ppp, *dead;
+	unsigned i;
+
+	dead = NULL;
+	spinlock_acquire(&pagecache_lock);
+	pc = vn->vn_pages;
+	if (all) {
+		vn->vn_pages = NULL;
+	}
+	for (i = 0; pc != NULL && i < PC_BUCKETS; i++) {
+		ppp = &pc->pc_buckets[i];
+		while ((pp = *ppp) != NULL) {
+			/* only the cache's own reference left: unmapped */
+			if (all || pp->pp_kind == PC_TEXT ||
+			    frame_refcount(pp->pp_pa) == 1) {
+				*ppp = pp->pp_next;
+				pp->pp_next = dead;
+				dead = pp;
+				pagecache_frames[pp->pp_pa / PAGE_SIZE] = NULL;
+				pagecache_npages[pp->pp_kind]--;
+			}
+			else {
+				ppp = &pp->pp_next;
+			}
+		}
+	}
+	spinlock_release(&pagecache_lock);
+
+	while ((pp = dead) != NULL) {
+		dead = pp->pp_next;
+		free_kpages(PADDR_TO_KVADDR(pp->pp_pa));
+		kfree(pp);
+	}
+	if (all && pc != NULL) {
+		kfree(pc);
+	}
+}
+
+void
+pagecache_update(struct vnode *vn, off_t start, off_t end)
+{
+	struct iovec iov;
+	struct uio ku;
+	struct pc_page *pp;
+	off_t page, from, to;
+	paddr_t pa;
+	vaddr_t kva;
+
+	for (page = start - start % PAGE_SIZE; page < end;
+	     page += PAGE_SIZE) {
+		/* not pagecache_get: this is no hit or miss */
+		pa = 0;
+		spinlock_acquire(&pagecache_lock);
+		if (vn->vn_pages != NULL) {
+			pp = pagecache_find(vn->vn_pages, PC_FILE, page);
+			if (pp != NULL) {
+				pa = pp->pp_pa;
+				frame_incref(pa);
+			}
+		}
+		spinlock_release(&pagecache_lock);
+		if (pa == 0) {
+			continue;
+		}
+
+		from = page < start ? start : page;
+		to = page + PAGE_SIZE > end ? end : page + PAGE_SIZE;
+		kva = PADDR_TO_KVADDR(pa) + (vaddr_t)(from - page);
+		uio_kinit(&iov, &ku, (void *)kva, to - from, from, UIO_READ);
+		/* the write just succeeded, so this should too */
+		(void)VOP_READ(vn, &ku);
+		free_kpages(PADDR_TO_KVADDR(pa));
+	}
+}
+
+bool
+pagecache_holds(paddr_t pa)
+{
+	/* racy; see pagecache.h */
+	return pagecache_frames[pa / PAGE_SIZE] != NULL;
+}
+
+bool
+pagecache_evict(paddr_t pa, unsigned refs)
+{
+	struct pc_page *pp, **ppp;
+
+	spinlock_acquire(&pagecache_lock);
+	pp = pagecache_frames[pa / PAGE_SIZE];
+	if (pp == NULL || frame_refcount(pa) != refs) {
+		spinlock_release(&pagecache_lock);
+		return false;
+	}
+	ppp = &pp->pp_vn->vn_pages->pc_buckets[PC_HASH(pp->pp_key)];
+	while (*ppp != pp) {
+		ppp = &(*ppp)->pp_next;
+	}
+	*ppp = pp->pp_next;
+	pagecache_frames[pa / PAGE_SIZE] = NULL;
+	pagecache_npages[pp->pp_kind]--;
+	pagecache_evicted++;
+	spinlock_release(&pagecache_lock);
+
+	kfree(pp);
+	free_kpages(PADDR_TO_KVADDR(pa));
+	return true;
+}
+
+struct vnode *
+pagecache_file(paddr_t pa, off_t *off)
+{
+	struct pc_page *pp;
+	struct vnode *vn = NULL;
+
+	spinlock_acquire(&pagecache_lock);
+	pp = pagecache_frames[pa / PAGE_SIZE];
+	if (pp != NULL && pp->pp_kind == PC_FILE) {
+		vn = pp->pp_vn;
+		VOP_INCREF(vn);
+		*off = pp->pp_key;
+	}
+	spinlock_release(&pagecache_lock);
+	return vn;
+}
+
+size_t
+pagecache_stats_format(char *buf, size_t len)
+{
+	size_t pos = 0;
+
+	/* racy reads; only for the stats */
+	SYSSTATS_PRINTF(buf, len, pos, "%u text pages, %u file pages cached; "
+		  "%u hits, %u misses, %u evicted\n",
+		  pagecache_npages[PC_TEXT], pagecache_npages[PC_FILE],
+		  pagecache_hits, pagecache_misses, pagecache_evicted);
+	return pos;
+}
@@ -0,0 +1,128 @@
+/*
+ * Two-level page tables; see pagetable.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <vm.h>
+#include <pagetable.h>
+#include <swap.h>
+
+struct pagetable *
+pt_create(struct addrspace *as)
+{
+	struct pagetable *pt;
+	unsigned i;
+
+	pt = kmalloc(sizeof(*pt));
+	if (pt == NULL) {
+		return NULL;
+	}
+	for (i=0; i<PT_L1_SIZE; i++) {
+		pt->pt_l2[i] = NULL;
+	}
+	pt->pt_as = as;
+	return pt;
+}
+
+void
+pt_destroy(struct pagetable *pt)
+{
+	pte_t *l2;
+	unsigned i, j;
+
+	/*
+	 * Stop any CPU that last ran this address space from walking
+	 * it. None of them can be running it now.
+	 */
+	for (i=0; i<MAXCPUS; i++) {
+		if (cpupagetables[i] == pt) {
+			cpupagetables[i] = NULL;
+		}
+	}
+
+	for (i=0; i<PT_L1_SIZE; i++) {
+		l2 = pt->pt_l2[i];
+		if (l2 == NULL) {
+			continue;
+		}
+		for (j=0; j<PT_L2_SIZE; j++) {
+			KASSERT((l2[j] & PTE_BUSY) == 0);
+			if (l2[j] & PTE_SWAP) {
+				swap_freeslot(l2[j]);
+			}
+			else if (l2[j] & (PTE_VALID | PTE_IDLE)) {
+				swap_freeframe(l2[j] & PTE_FRAME, pt->pt_as);
+			}
+		}
+		free_kpages((vaddr_t)l2);
+	}
+	kfree(pt);
+}
+
+pte_t *
+pt_lookup(struct pagetable *pt, vaddr_t va, bool create)
+{
+	pte_t *l2;
+
+	KASSERT(va < USERSPACETOP);
+
+	l2 = pt->pt_l2[PT_L1_INDEX(va)];
+	if (l2 == NULL) {
+		if (!create) {
+			return NULL;
+		}
+		l2 = (pte_t *)alloc_zeroed_kpage();
+		if (l2 == NULL) {
+			return NULL;
+		}
+		pt->pt_l2[PT_L1_INDEX(va)] = l2;
+	}
+	return &l2[PT_L2_INDEX(va)];
+}
+
+int
+pt_copy(struct pagetable *old, struct pagetable *new)
+{
+	pte_t *oldl2, *newl2;
+	unsigned i, j;
+	int result;
+
+	for (i=0; i<PT_L1_SIZE; i++) {
+		oldl2 = old->pt_l2[i];
+		if (oldl2 == NULL) {
+			continue;
+		}
+		newl2 = (pte_t *)alloc_zeroed_kpage();
+		if (newl2 == NULL) {
+			return ENOMEM;
+		}
+		/* the caller destroys NEW on failure, which drops these */
+		new->pt_l2[i] = newl2;
+
+		for (j=0; j<PT_L2_SIZE; j++) {
+			if (oldl2[j] & (PTE_SWAP | PTE_BUSY)) {
+				result = swap_pagein(old->pt_as,
+					(i << PT_L1_SHIFT) | (j << 12),
+					&oldl2[j]);
+				if (result) {
+					return result;
+				}
+			}
+			if (oldl2[j] & PTE_IDLE) {
+				/* sharing it counts as a use */
+				oldl2[j] = (oldl2[j] & ~PTE_IDLE) | PTE_VALID;
+			}
+			if ((oldl2[j] & PTE_VALID) == 0) {
+				continue;
+			}
+			if ((oldl2[j] & (PTE_WRITE | PTE_SHARED)) == PTE_WRITE) {
+				oldl2[j] = (oldl2[j] & ~PTE_WRITE) | PTE_COW;
+			}
+			frame_incref(oldl2[j] & PTE_FRAME);
+			newl2[j] = oldl2[j];
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,594 @@
+/*
+ * Paging to the swap disk; see swap.h.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <bitmap.h>
+#include <synch.h>
+#include <thread.h>
+#include <uio.h>
+#include <vfs.h>
+#include <vnode.h>
+#include <addrspace.h>
+#include <vm.h>
+#include <pagetable.h>
+#include <pagecache.h>
+#include <swap.h>
+#include <sysstats.h>
+
+/* pages paged out, and written to the disk together, per pass */
+#define SWAP_BATCH 8
+
+/* free frames to keep in hand; at most a sixteenth of RAM */
+#define SWAP_FREEMIN 16
+
+/* the user page a frame holds, if any */
+struct swap_frame {
+	struct addrspace *sf_as;	/* NULL for none */
+	vaddr_t sf_va;
+};
+
+/* a page on its way out */
+struct swap_victim {
+	struct addrspace *sv_as;
+	vaddr_t sv_va;
+	unsigned sv_slot;
+};
+
+/* a dirty page of a shared mapping being written back to its file */
+struct swap_dirty {
+	struct addrspace *sd_as;	/* the mapping it was found in */
+	vaddr_t sd_va;
+	paddr_t sd_pa;			/* with a reference held */
+	struct vnode *sd_vn;		/* likewise */
+	off_t sd_off;
+	int sd_result;
+};
+
+/* all protected by vm_lock */
+static struct vnode *swap_vn;		/* the swap disk, or NULL */
+static struct bitmap *swap_slots;	/* slots in use */
+static unsigned swap_nslots;
+static unsigned swap_nused;
+static struct swap_frame *swap_frames;	/* indexed by frame number */
+static unsigned swap_nframes;
+static unsigned swap_hand;		/* the clock hand, a frame number */
+static unsigned swap_freemin;
+static char *swap_buf;			/* SWAP_BATCH pages being written */
+static struct cv *swap_cv;		/* the pageout thread waits here */
+static struct cv *swap_donecv;		/* for frames, or pages in transit */
+static unsigned swap_waiting;		/* allocations waiting for frames */
+static uint32_t swap_stuck;		/* passes that found nothing to do */
+
+/* counters for the stats */
+static uint32_t swap_npageout, swap_nwrites, swap_npagein, swap_nidled;
+static uint32_t swap_nevicted, swap_ncleaned;
+
+/*
+ * Read or write NPAGES pages at BUF from or to the swap disk,
+ * starting at SLOT.
+ */
+static
+int
+swap_io(unsigned slot, void *buf, unsigned npages, enum uio_rw rw)
+{
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	uio_kinit(&iov, &ku, buf, npages * PAGE_SIZE,
+		  (off_t)slot * PAGE_SIZE, rw);
+	if (rw == UIO_READ) {
+		result = VOP_READ(swap_vn, &ku);
+	}
+	else {
+		result = VOP_WRITE(swap_vn, &ku);
+	}
+	if (result == 0 && ku.uio_resid != 0) {
+		result = EIO;
+	}
+	return result;
+}
+
+/*
+ * Take a free slot, HINT if that is free so that a batch lands in
+ * one run of slots. Returns false if the disk is full.
+ */
+static
+bool
+swap_getslot(unsigned hint, unsigned *slot)
+{
+	if (hint < swap_nslots && !bitmap_isset(swap_slots, hint)) {
+		bitmap_mark(swap_slots, hint);
+		*slot = hint;
+	}
+	else if (bitmap_alloc(swap_slots, slot)) {
+		return false;
+	}
+	swap_nused++;
+	return true;
+}
+
+/*
+ * Deal with the idle page in frame PA, which holds a page cache page
+ * that only SF's mapping, entry PTE, maps. A clean one is dropped
+ * from the cache and unmapped, to be read in again on its next
+ * touch. A dirty page of a shared mapping is marked clean and added
+ * to DIRTY, to be written back to the file; if it is still clean and
+ * idle the next time round, it goes then. Returns false if neither
+ * could be done.
+ */
+static
+bool
+swap_dropcached(struct swap_frame *sf, paddr_t pa, pte_t *pte,
+		struct swap_dirty *dirty, unsigned *ndirty)
+{
+	struct swap_dirty *sd;
+
+	if ((*pte & (PTE_SHARED | PTE_WRITE)) == (PTE_SHARED | PTE_WRITE)) {
+		sd = &dirty[*ndirty];
+		sd->sd_vn = pagecache_file(pa, &sd->sd_off);
+		if (sd->sd_vn == NULL) {
+			/* dropped from the cache meanwhile */
+			return false;
+		}
+		/* the next write marks it dirty again */
+		*pte &= ~PTE_WRITE;
+		frame_incref(pa);
+		sd->sd_as = sf->sf_as;
+		sd->sd_va = sf->sf_va;
+		sd->sd_pa = pa;
+		sd->sd_as->as_paging++;
+		(*ndirty)++;
+		return true;
+	}
+
+	if (!pagecache_evict(pa, 2)) {
+		return false;
+	}
+	*pte = 0;
+	sf->sf_as = NULL;
+	free_kpages(PADDR_TO_KVADDR(pa));
+	swap_nevicted++;
+	return true;
+}
+
+/*
+ * Run the clock hand until SWAP_BATCH pages have been dealt with or
+ * it has gone round twice. Page cache pages nothing maps are dropped
+ * straight away. Others are given a second chance first, and then
+ * those in the page cache go to swap_dropcached, and anonymous ones
+ * are unmapped, copied into swap_buf for VICTIMS and their frames
+ * freed. Returns how many pages were dealt with, and in *NVICTIMS
+ * and *NDIRTY how many of them are in VICTIMS and DIRTY.
+ */
+static
+unsigned
+swap_choose(struct swap_victim *victims, unsigned *nvictims,
+	    struct swap_dirty *dirty, unsigned *ndirty)
+{
+	struct swap_frame *sf;
+	struct swap_victim *sv;
+	unsigned scanned, n, slot;
+	paddr_t pa;
+	pte_t *pte;
+	bool cached;
+
+	n = *nvictims = *ndirty = 0;
+	for (scanned = 0; scanned < 2 * swap_nframes && n < SWAP_BATCH;
+	     scanned++) {
+		sf = &swap_frames[swap_hand];
+		pa = swap_hand * PAGE_SIZE;
+		swap_hand = (swap_hand + 1) % swap_nframes;
+
+		if (sf->sf_as == NULL) {
+			/* a cached page nothing maps any more goes first */
+			if (pagecache_evict(pa, 1)) {
+				swap_nevicted++;
+				n++;
+			}
+			continue;
+		}
+
+		/* mapped elsewhere too, or shared copy-on-write */
+		cached = pagecache_holds(pa);
+		if (frame_refcount(pa) != (cached ? 2U : 1U)) {
+			continue;
+		}
+
+		pte = pt_lookup(sf->sf_as->as_pt, sf->sf_va, false);
+		KASSERT(pte != NULL && (*pte & PTE_FRAME) == pa);
+
+		if (!cached && ((*pte & PTE_SHARED) || swap_vn == NULL)) {
+			/* nowhere to put it */
+			continue;
+		}
+
+		if (*pte & PTE_VALID) {
+			/* give it a second chance; see if it gets used */
+			*pte = (*pte & ~PTE_VALID) | PTE_IDLE;
+			vm_tlbinval(sf->sf_as, sf->sf_va);
+			swap_nidled++;
+			continue;
+		}
+		KASSERT(*pte & PTE_IDLE);
+
+		if (cached) {
+			if (swap_dropcached(sf, pa, pte, dirty, ndirty)) {
+				n++;
+			}
+			continue;
+		}
+
+		if (!swap_getslot(*nvictims > 0 ?
+				  victims[*nvictims-1].sv_slot + 1 : 0,
+				  &slot)) {
+			break;
+		}
+		*pte = slot * PAGE_SIZE | (*pte & ~(PTE_FRAME | PTE_IDLE)) |
+			PTE_SWAP | PTE_BUSY;
+		memcpy(swap_buf + *nvictims * PAGE_SIZE,
+		       (void *)PADDR_TO_KVADDR(pa), PAGE_SIZE);
+
+		sv = &victims[(*nvictims)++];
+		sv->sv_as = sf->sf_as;
+		sv->sv_va = sf->sf_va;
+		sv->sv_slot = slot;
+		sv->sv_as->as_paging++;
+		n++;
+
+		sf->sf_as = NULL;
+		free_kpages(PADDR_TO_KVADDR(pa));
+	}
+	return n;
+}
+
+/*
+ * Write the N pages in swap_buf out, one write per run of adjacent
+ * slots, and return the number of writes. Called without vm_lock.
+ */
+static
+unsigned
+swap_write(const struct swap_victim *victims, unsigned n)
+{
+	unsigned k, end, nwrites;
+	int result;
+
+	nwrites = 0;
+	for (k = 0; k < n; k = end) {
+		end = k + 1;
+		while (end < n &&
+		       victims[end].sv_slot == victims[end-1].sv_slot + 1) {
+			end++;
+		}
+		result = swap_io(victims[k].sv_slot, swap_buf + k * PAGE_SIZE,
+				 end - k, UIO_WRITE);
+		if (result) {
+			panic("swap: writing slot %u: %s\n",
+			      victims[k].sv_slot, strerror(result));
+		}
+		nwrites++;
+	}
+	return nwrites;
+}
+
+/*
+ * Write the N pages in DIRTY back to their files, recording how each
+ * write went. Called without vm_lock.
+ */
+static
+void
+swap_clean(struct swap_dirty *dirty, unsigned n)
+{
+	unsigned k;
+
+	for (k = 0; k < n; k++) {
+		dirty[k].sd_result = vm_writefilepage(dirty[k].sd_vn,
+						      dirty[k].sd_off,
+						      dirty[k].sd_pa);
+		if (dirty[k].sd_result) {
+			kprintf("swap: writing back a mapped page: %s\n",
+				strerror(dirty[k].sd_result));
+		}
+		VOP_DECREF(dirty[k].sd_vn);
+	}
+}
+
+static
+void
+swap_pageout_thread(void *data1, unsigned long data2)
+{
+	struct swap_victim victims[SWAP_BATCH];
+	struct swap_dirty dirty[SWAP_BATCH];
+	struct swap_dirty *sd;
+	unsigned n, k, nvictims, ndirty, nwrites;
+	pte_t *pte;
+
+	(void)data1;
+	(void)data2;
+
+	lock_acquire(vm_lock);
+	while (1) {
+		while (swap_waiting == 0 && frame_nfree() >= swap_freemin) {
+			cv_wait(swap_cv, vm_lock);
+		}
+
+		n = swap_choose(victims, &nvictims, dirty, &ndirty);
+		if (n == 0) {
+			/* nothing that can go, or no room on the disk */
+			swap_stuck++;
+			cv_broadcast(swap_donecv, vm_lock);
+			cv_wait(swap_cv, vm_lock);
+			continue;
+		}
+		/* the frames are free already, except the dirty ones */
+		cv_broadcast(swap_donecv, vm_lock);
+
+		lock_release(vm_lock);
+		nwrites = swap_write(victims, nvictims);
+		swap_clean(dirty, ndirty);
+		lock_acquire(vm_lock);
+
+		for (k = 0; k < nvictims; k++) {
+			pte = pt_lookup(victims[k].sv_as->as_pt,
+					victims[k].sv_va, false);
+			*pte &= ~PTE_BUSY;
+			victims[k].sv_as->as_paging--;
+		}
+		for (k = 0; k < ndirty; k++) {
+			sd = &dirty[k];
+			pte = pt_lookup(sd->sd_as->as_pt, sd->sd_va, false);
+			if (sd->sd_result && pte != NULL &&
+			    (*pte & (PTE_VALID | PTE_IDLE)) &&
+			    (*pte & PTE_FRAME) == sd->sd_pa) {
+				/* not written, so still dirty */
+				*pte |= PTE_WRITE;
+			}
+			sd->sd_as->as_paging--;
+			free_kpages(PADDR_TO_KVADDR(sd->sd_pa));
+		}
+		swap_npageout += nvictims;
+		swap_nwrites += nwrites;
+		swap_ncleaned += ndirty;
+		cv_broadcast(swap_donecv, vm_lock);
+	}
+}
+
+/*
+ * Open the swap disk and set up its slots, or leave swap_vn NULL if
+ * there is none.
+ */
+static
+void
+swap_opendisk(void)
+{
+	char path[] = "lhd1raw:";
+	struct vnode *vn;
+	struct stat st;
+	int result;
+
+	result = vfs_open(path, O_RDWR, 0, &vn);
+	if (result) {
+		kprintf("swap: no swap disk: %s\n", strerror(result));
+		return;
+	}
+	result = VOP_STAT(vn, &st);
+	if (result) {
+		panic("swap: stat of %s: %s\n", path, strerror(result));
+	}
+
+	/* slot numbers go in PTE_FRAME */
+	swap_nslots = st.st_size / PAGE_SIZE;
+	if (swap_nslots > PTE_FRAME / PAGE_SIZE + 1) {
+		swap_nslots = PTE_FRAME / PAGE_SIZE + 1;
+	}
+	swap_slots = bitmap_create(swap_nslots);
+	swap_buf = (char *)alloc_kpages(SWAP_BATCH);
+	if (swap_slots == NULL || swap_buf == NULL) {
+		panic("swap_bootstrap: out of memory\n");
+	}
+	swap_vn = vn;
+	kprintf("swap: %uk on %s\n", swap_nslots * PAGE_SIZE / 1024, path);
+}
+
+void
+swap_bootstrap(void)
+{
+	unsigned i;
+	int result;
+
+	swap_nframes = ram_getsize() / PAGE_SIZE;
+	swap_frames = kmalloc(swap_nframes * sizeof(*swap_frames));
+	swap_cv = cv_create("swap");
+	swap_donecv = cv_create("swapdone");
+	if (swap_frames == NULL || swap_cv == NULL || swap_donecv == NULL) {
+		panic("swap_bootstrap: out of memory\n");
+	}
+	for (i = 0; i < swap_nframes; i++) {
+		swap_frames[i].sf_as = NULL;
+	}
+
+	/* kept free by the pageout thread, and by swap_tryframe */
+	swap_freemin = swap_nframes / 16;
+	if (swap_freemin > SWAP_FREEMIN) {
+		swap_freemin = SWAP_FREEMIN;
+	}
+
+	swap_opendisk();
+
+	/* even without a disk, it evicts page cache pages */
+	result = thread_fork("pageout", NULL, swap_pageout_thread, NULL, 0);
+	if (result) {
+		panic("swap: thread_fork: %s\n", strerror(result));
+	}
+}
+
+paddr_t
+swap_allocframe(bool zero)
+{
+	vaddr_t kva;
+	uint32_t stuck;
+
+	KASSERT(lock_do_i_hold(vm_lock));
+
+	while (1) {
+		kva = zero ? alloc_zeroed_kpage() : alloc_kpages(1);
+		if (kva != 0) {
+			break;
+		}
+
+		stuck = swap_stuck;
+		swap_waiting++;
+		cv_signal(swap_cv, vm_lock);
+		cv_wait(swap_donecv, vm_lock);
+		swap_waiting--;
+		if (swap_stuck != stuck) {
+			/* nothing more can be paged out; one last try */
+			kva = zero ? alloc_zeroed_kpage() : alloc_kpages(1);
+			break;
+		}
+	}
+	if (kva == 0) {
+		return 0;
+	}
+
+	if (frame_nfree() < swap_freemin) {
+		/* page out ahead of need */
+		cv_signal(swap_cv, vm_lock);
+	}
+	return KVADDR_TO_PADDR(kva);
+}
+
+paddr_t
+swap_tryframe(bool zero)
+{
+	vaddr_t kva;
+
+	KASSERT(lock_do_i_hold(vm_lock));
+
+	if (frame_nfree() <= swap_freemin) {
+		return 0;
+	}
+	kva = zero ? alloc_zeroed_kpage() : alloc_kpages(1);
+	if (kva == 0) {
+		return 0;
+	}
+	return KVADDR_TO_PADDR(kva);
+}
+
+void
+swap_setowner(paddr_t pa, struct addrspace *as, vaddr_t va)
+{
+	struct swap_frame *sf = &swap_frames[pa / PAGE_SIZE];
+
+	KASSERT(lock_do_i_hold(vm_lock));
+	sf->sf_as = as;
+	sf->sf_va = va;
+}
+
+void
+swap_freeframe(paddr_t pa, struct addrspace *as)
+{
+	struct swap_frame *sf = &swap_frames[pa / PAGE_SIZE];
+
+	KASSERT(lock_do_i_hold(vm_lock));
+	/*
+	 * If the frame is still shared, whoever is left has no claim
+	 * on it and it stays put until they write to it.
+	 */
+	if (sf->sf_as == as) {
+		sf->sf_as = NULL;
+	}
+	free_kpages(PADDR_TO_KVADDR(pa));
+}
+
+int
+swap_pagein(struct addrspace *as, vaddr_t va, pte_t *pte)
+{
+	unsigned slot;
+	paddr_t pa;
+	int result;
+
+	KASSERT(lock_do_i_hold(vm_lock));
+
+	while (*pte & PTE_BUSY) {
+		cv_wait(swap_donecv, vm_lock);
+	}
+	KASSERT(*pte & PTE_SWAP);
+
+	pa = swap_allocframe(false);
+	if (pa == 0) {
+		return ENOMEM;
+	}
+
+	slot = (*pte & PTE_FRAME) / PAGE_SIZE;
+	*pte |= PTE_BUSY;
+	as->as_paging++;
+
+	lock_release(vm_lock);
+	result = swap_io(slot, (void *)PADDR_TO_KVADDR(pa), 1, UIO_READ);
+	lock_acquire(vm_lock);
+
+	as->as_paging--;
+	*pte &= ~PTE_BUSY;
+	cv_broadcast(swap_donecv, vm_lock);
+	if (result) {
+		free_kpages(PADDR_TO_KVADDR(pa));
+		return result;
+	}
+
+	swap_freeslot(*pte);
+	*pte = pa | (*pte & ~(PTE_FRAME | PTE_SWAP)) | PTE_VALID;
+	swap_setowner(pa, as, va);
+	swap_npagein++;
+	return 0;
+}
+
+void
+swap_freeslot(pte_t pte)
+{
+	KASSERT(lock_do_i_hold(vm_lock));
+	KASSERT(pte & PTE_SWAP);
+
+	bitmap_unmark(swap_slots, (pte & PTE_FRAME) / PAGE_SIZE);
+	swap_nused--;
+}
+
+void
+swap_wait(struct addrspace *as)
+{
+	KASSERT(lock_do_i_hold(vm_lock));
+
+	while (as->as_paging > 0) {
+		cv_wait(swap_donecv, vm_lock);
+	}
+}
+
+size_t
+swap_stats_format(char *buf, size_t len)
+{
+	size_t pos = 0;
+
+	/* racy reads; only for the stats */
+	if (swap_vn == NULL) {
+		SYSSTATS_PRINTF(buf, len, pos, "no swap disk\n");
+	}
+	else {
+		SYSSTATS_PRINTF(buf, len, pos, "%u of %u slots in use\n",
+			    swap_nused, swap_nslots);
+		SYSSTATS_PRINTF(buf, len, pos,
+			    "%u pages out in %u writes, %u pages in\n",
+			    swap_npageout, swap_nwrites, swap_npagein);
+	}
+	SYSSTATS_PRINTF(buf, len, pos,
+		    "%u cached pages evicted, %u written back first\n",
+		    swap_nevicted, swap_ncleaned);
+	SYSSTATS_PRINTF(buf, len, pos,
+		    "%u second chances, %u passes with nothing to page out\n",
+		    swap_nidled, swap_stuck);
+	return pos;
+}
@@ -0,0 +1,835 @@
+/*
+ * Demand-paged VM: the page fault handler.
+ *
+ * User pages are allocated one at a time, the first time they are
+ * touched, and zeroed or read from the executable, so a process only
+ * holds the pages it has used rather than everything its segments
+ * declare, and exec costs nothing per page up front. The mapping lives in
+ * the address space's page table (pagetable.h); the TLB is a cache
+ * of it. Misses on resident pages are refilled by utlb_refill in
+ * exception-mips1.S without coming here at all; vm_fault handles the
+ * rest, loading a random TLB slot just as the refill does.
+ *
+ * TLB entries are tagged with address space IDs, so switching
+ * between processes does not flush the TLB. Each CPU hands out its
+ * own ASIDs in generations: an address space keeps the ASID it was
+ * given on a CPU for as long as that CPU's generation lasts, and
+ * when a CPU runs out it starts a new generation, which is the only
+ * time its TLB is flushed. ASID 0 is never handed out; it is in
+ * effect when no address space is.
+ *
+ * Regions made by mmap are served from the file's page cache instead
+ * (pagecache.h), and dirty pages of shared ones written back to the
+ * file by vm_syncpages.
+ *
+ * A first touch also maps whatever pages around it can be had
+ * cheaply (vm_prefault), to save sequential scans a fault a page.
+ *
+ * When memory runs out pages are paged out to swap; see swap.h.
+ * Faults are serialized by vm_lock so that the pageout thread can
+ * take a page away between them.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/mman.h>
+#include <kern/stat.h>
+#include <lib.h>
+#include <spl.h>
+#include <proc.h>
+#include <current.h>
+#include <cpu.h>
+#include <mips/tlb.h>
+#include <platform/maxcpus.h>
+#include <addrspace.h>
+#include <pagetable.h>
+#include <vm.h>
+#include <uio.h>
+#include <vnode.h>
+#include <synch.h>
+#include <swap.h>
+#include <pagecache.h>
+#include <sysstats.h>
+
+/*
+ * Per-CPU state for utlb_refill, indexed by CPU number like
+ * cpustacks[]. See pagetable.h.
+ */
+struct pagetable *cpupagetables[MAXCPUS];
+uint32_t cputlbrefills[MAXCPUS];
+
+/*
+ * The rest of the per-CPU TLB state, only touched by its own CPU
+ * with interrupts off (and read racily by vm_tlbstats_format).
+ */
+struct vm_tlbcpu {
+	uint32_t tc_faults;		/* misses that came to vm_fault */
+	uint32_t tc_flushes;		/* whole-TLB flushes */
+	unsigned tc_asid;		/* ASID in effect */
+	unsigned tc_nextasid;		/* next ASID to hand out */
+	uint32_t tc_asidgen;		/* current ASID generation */
+	uint32_t tc_rollovers;		/* ASID generations used up */
+};
+
+static struct vm_tlbcpu vm_tlbcpus[MAXCPUS];
+
+struct lock *vm_lock;
+
+unsigned vm_faultaround = 16;
+
+/* counts finished TLB shootdowns; only used with vm_lock held */
+static struct semaphore *vm_tlbsem;
+
+void
+vm_bootstrap(void)
+{
+	/* page table entries go into the TLB unchanged */
+	KASSERT(PTE_WRITE == TLBLO_DIRTY);
+	KASSERT(PTE_VALID == TLBLO_VALID);
+
+	/* ram_bootstrap has already set up the frame table */
+
+	vm_lock = lock_create("vm");
+	vm_tlbsem = sem_create("vm_tlbsem", 0);
+	if (vm_lock == NULL || vm_tlbsem == NULL) {
+		panic("vm_bootstrap: out of memory\n");
+	}
+	pagecache_bootstrap();
+	swap_bootstrap();
+}
+
+void
+vm_tlbflush(void)
+{
+	struct vm_tlbcpu *tc;
+	int i, spl;
+
+	/* Disable interrupts on this CPU while frobbing the TLB. */
+	spl = splhigh();
+	for (i=0; i<NUM_TLB; i++) {
+		tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+	}
+	tc = &vm_tlbcpus[curcpu->c_number];
+	tc->tc_flushes++;
+	/* tlb_write took the PID with it */
+	tlb_setasid(tc->tc_asid);
+	splx(spl);
+}
+
+void
+vm_tlbactivate(struct addrspace *as)
+{
+	struct vm_tlbcpu *tc;
+	unsigned cpu;
+	int spl;
+
+	spl = splhigh();
+	cpu = curcpu->c_number;
+	tc = &vm_tlbcpus[cpu];
+
+	if (as == NULL) {
+		cpupagetables[cpu] = NULL;
+		tc->tc_asid = 0;
+		tlb_setasid(0);
+		splx(spl);
+		return;
+	}
+
+	if (as->as_asid[cpu] == 0 ||
+	    as->as_asid[cpu] / NUM_ASID != tc->tc_asidgen) {
+		/* none from this generation; hand out the next one */
+		if (tc->tc_nextasid == 0 || tc->tc_nextasid == NUM_ASID) {
+			/* every ASID now in the TLB goes out of date */
+			tc->tc_asidgen++;
+			tc->tc_nextasid = 1;
+			tc->tc_rollovers++;
+			vm_tlbflush();
+		}
+		as->as_asid[cpu] = tc->tc_asidgen * NUM_ASID +
+			tc->tc_nextasid++;
+	}
+
+	cpupagetables[cpu] = as->as_pt;
+	tc->tc_asid = as->as_asid[cpu] % NUM_ASID;
+	tlb_setasid(tc->tc_asid);
+	splx(spl);
+}
+
+void
+vm_tlbflush_as(struct addrspace *as)
+{
+	unsigned i;
+
+	/*
+	 * With no ASID recorded, each CPU hands out a new one the next
+	 * time it activates AS, and entries tagged with the old ones
+	 * can never match again.
+	 */
+	for (i=0; i<MAXCPUS; i++) {
+		as->as_asid[i] = 0;
+	}
+	if (as == proc_getas()) {
+		vm_tlbactivate(as);
+	}
+}
+
+/*
+ * Drop AS's entry for VADDR, if any, from this CPU's TLB. Only its
+ * ASID from the current generation here can have one.
+ */
+static
+void
+vm_tlbinval_local(struct addrspace *as, vaddr_t vaddr)
+{
+	struct vm_tlbcpu *tc;
+	uint32_t asid;
+	int i, spl;
+
+	spl = splhigh();
+	tc = &vm_tlbcpus[curcpu->c_number];
+	asid = as->as_asid[curcpu->c_number];
+	if (asid != 0 && asid / NUM_ASID == tc->tc_asidgen) {
+		i = tlb_probe(vaddr | ((asid % NUM_ASID) << TLBHI_PIDSHIFT),
+			      0);
+		if (i >= 0) {
+			tlb_write(TLBHI_INVALID(i), TLBLO_INVALID(), i);
+		}
+		/* the probe took the PID with it */
+		tlb_setasid(tc->tc_asid);
+	}
+	splx(spl);
+}
+
+void
+vm_tlbshootdown(const struct tlbshootdown *ts)
+{
+	vm_tlbinval_local(ts->ts_as, ts->ts_vaddr);
+	V(ts->ts_done);
+}
+
+/*
+ * Only CPUs where AS has an ASID from their current generation can
+ * hold an entry for it, so only they get a shootdown. Reading another
+ * CPU's generation is racy, but it only ever goes up: a stale one
+ * at worst sends a shootdown that finds nothing.
+ */
+void
+vm_tlbinval(struct addrspace *as, vaddr_t vaddr)
+{
+	struct tlbshootdown ts;
+	uint32_t cpus, asid;
+	unsigned i, n;
+	int spl;
+
+	KASSERT(lock_do_i_hold(vm_lock));
+	COMPILE_ASSERT(MAXCPUS <= 32);
+
+	ts.ts_as = as;
+	ts.ts_vaddr = vaddr;
+	ts.ts_done = vm_tlbsem;
+
+	cpus = 0;
+	for (i=0; i<MAXCPUS; i++) {
+		asid = as->as_asid[i];
+		if (asid != 0 && asid / NUM_ASID == vm_tlbcpus[i].tc_asidgen) {
+			cpus |= (uint32_t)1 << i;
+		}
+	}
+
+	/* don't move to another CPU between the two */
+	spl = splhigh();
+	vm_tlbinval_local(as, vaddr);
+	n = ipi_tlbshootdown_cpus(cpus, &ts);
+	splx(spl);
+
+	while (n-- > 0) {
+		P(vm_tlbsem);
+	}
+}
+
+/*
+ * Load a translation into the TLB. An existing entry for the page is
+ * overwritten in place; otherwise the entry goes in a random slot,
+ * the same as the fast refill path in exception-mips1.S does.
+ */
+static
+void
+vm_tlbload(vaddr_t vaddr, uint32_t elo)
+{
+	struct vm_tlbcpu *tc;
+	uint32_t ehi;
+	int i, spl;
+
+	spl = splhigh();
+
+	tc = &vm_tlbcpus[curcpu->c_number];
+	ehi = vaddr | (tc->tc_asid << TLBHI_PIDSHIFT);
+
+	i = tlb_probe(ehi, 0);
+	if (i < 0) {
+		tlb_random(ehi, elo);
+	}
+	else {
+		tlb_write(ehi, elo, i);
+	}
+
+	splx(spl);
+}
+
+size_t
+vm_tlbstats_format(char *buf, size_t len)
+{
+	struct vm_tlbcpu *tc;
+	size_t pos = 0;
+	unsigned n;
+
+	SYSSTATS_PRINTF(buf, len, pos, "%-4s %10s %10s %10s %10s\n",
+		  "cpu", "fastrefill", "faults", "flushes", "asidgens");
+	for (n = 0; n < MAXCPUS; n++) {
+		tc = &vm_tlbcpus[n];
+		if (cputlbrefills[n] == 0 && tc->tc_faults == 0 &&
+		    tc->tc_flushes == 0) {
+			continue;
+		}
+		SYSSTATS_PRINTF(buf, len, pos, "%-4u %10u %10u %10u %10u\n",
+			  n, cputlbrefills[n], tc->tc_faults,
+			  tc->tc_flushes, tc->tc_rollovers);
+	}
+	return pos;
+}
+
+/*
+ * Break copy-on-write sharing of the page at VADDR, whose entry is
+ * PTE, for a write. If every other sharer has already taken its own
+ * copy, the frame is just made writable again; otherwise the page is
+ * copied and our reference to the shared frame dropped. Returns
+ * EAGAIN if the page went away while waiting for a frame.
+ */
+static
+int
+vm_cowbreak(struct addrspace *as, vaddr_t vaddr, pte_t *pte)
+{
+	paddr_t pa = *pte & PTE_FRAME;
+	paddr_t newpa;
+
+	if (frame_refcount(pa) > 1) {
+		newpa = swap_allocframe(false);
+		if (newpa == 0) {
+			return ENOMEM;
+		}
+		if ((*pte & PTE_VALID) == 0 || (*pte & PTE_FRAME) != pa) {
+			/* paged out meanwhile */
+			free_kpages(PADDR_TO_KVADDR(newpa));
+			return EAGAIN;
+		}
+		memcpy((void *)PADDR_TO_KVADDR(newpa),
+		       (void *)PADDR_TO_KVADDR(pa), PAGE_SIZE);
+		*pte = newpa | (*pte & ~PTE_FRAME);
+		swap_freeframe(pa, as);
+		pa = newpa;
+	}
+	*pte = (*pte & ~PTE_COW) | PTE_WRITE;
+	swap_setowner(pa, as, vaddr);
+	return 0;
+}
+
+/*
+ * Fill the new frame PA for the page at VADDR of file-backed region
+ * REG. The part of the page the file covers is read from it, and
+ * the rest, such as the start of the BSS, is zeroed. Sets *DIDREAD
+ * if the file had to be read at all.
+ */
+static
+int
+vm_readpage(struct region *reg, vaddr_t vaddr, paddr_t pa, bool *didread)
+{
+	char *kva = (char *)PADDR_TO_KVADDR(pa);
+	vaddr_t start, end;
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	start = vaddr;
+	if (start < reg->rg_filebase) {
+		start = reg->rg_filebase;
+	}
+	end = vaddr + PAGE_SIZE;
+	if (end > reg->rg_filebase + reg->rg_filesz) {
+		end = reg->rg_filebase + reg->rg_filesz;
+	}
+	if (start >= end) {
+		bzero(kva, PAGE_SIZE);
+		return 0;
+	}
+
+	bzero(kva, start - vaddr);
+	bzero(kva + (end - vaddr), vaddr + PAGE_SIZE - end);
+
+	uio_kinit(&iov, &ku, kva + (start - vaddr), end - start,
+		  reg->rg_fileoff + (start - reg->rg_filebase), UIO_READ);
+	*didread = true;
+	result = VOP_READ(reg->rg_vnode, &ku);
+	if (result) {
+		return result;
+	}
+	if (ku.uio_resid != 0) {
+		kprintf("vm: short read on segment - file truncated?\n");
+		return EIO;
+	}
+	return 0;
+}
+
+/*
+ * Allocate and fill the frame for the first touch of the page at
+ * VADDR in region REG of AS. Text pages read from a file go into
+ * the page cache. Sets *DIDREAD if that took a read from the file.
+ */
+static
+int
+vm_newpage(struct addrspace *as, struct region *reg, vaddr_t vaddr,
+	   paddr_t *ret, bool *didread)
+{
+	paddr_t pa, cached;
+	int result;
+
+	pa = swap_allocframe(reg->rg_vnode == NULL);
+	if (pa == 0) {
+		return ENOMEM;
+	}
+	if (reg->rg_vnode != NULL) {
+		/*
+		 * Nobody else touches our entries, and the frame has
+		 * no owner yet, so the disk can be waited for unlocked.
+		 */
+		lock_release(vm_lock);
+		result = vm_readpage(reg, vaddr, pa, didread);
+		lock_acquire(vm_lock);
+		if (result) {
+			free_kpages(PADDR_TO_KVADDR(pa));
+			return result;
+		}
+		if (!reg->rg_write) {
+			cached = pagecache_add(reg->rg_vnode, PC_TEXT, vaddr,
+					       pa);
+			if (cached != pa) {
+				/* another process read it in first */
+				free_kpages(PADDR_TO_KVADDR(pa));
+				pa = cached;
+			}
+		}
+	}
+	swap_setowner(pa, as, vaddr);
+	*ret = pa;
+	return 0;
+}
+
+/*
+ * Read the page of VN at offset OFF, a whole page of the file, into
+ * frame PA, zeroing whatever lies past the end of the file.
+ */
+static
+int
+vm_readfilepage(struct vnode *vn, off_t off, paddr_t pa)
+{
+	char *kva = (char *)PADDR_TO_KVADDR(pa);
+	struct iovec iov;
+	struct uio ku;
+	int result;
+
+	uio_kinit(&iov, &ku, kva, PAGE_SIZE, off, UIO_READ);
+	result = VOP_READ(vn, &ku);
+	if (result) {
+		return result;
+	}
+	bzero(kva + PAGE_SIZE - ku.uio_resid, ku.uio_resid);
+	return 0;
+}
+
+/*
+ * Read in the file's page at OFF for the first touch of a page of
+ * mmap region REG, and put it in the page cache, which every mapping
+ * of it shares. The caller records itself as the frame's owner.
+ */
+static
+int
+vm_mappage(struct region *reg, off_t off, paddr_t *ret)
+{
+	paddr_t pa;
+	int result;
+
+	pa = swap_allocframe(false);
+	if (pa == 0) {
+		return ENOMEM;
+	}
+	/* as in vm_newpage */
+	lock_release(vm_lock);
+	result = vm_readfilepage(reg->rg_vnode, off, pa);
+	lock_acquire(vm_lock);
+	if (result) {
+		free_kpages(PADDR_TO_KVADDR(pa));
+		return result;
+	}
+	*ret = pagecache_add(reg->rg_vnode, PC_FILE, off, pa);
+	if (*ret != pa) {
+		/* another process read it in first */
+		free_kpages(PADDR_TO_KVADDR(pa));
+	}
+	return 0;
+}
+
+/*
+ * Write the page at VADDR of shared mapping REG, in frame PA, back
+ * to the file: only the part the mapping covers, so the file never
+ * grows.
+ */
+static
+int
+vm_writepage(struct region *reg, vaddr_t vaddr, paddr_t pa)
+{
+	vaddr_t end;
+	struct iovec iov;
+	struct uio ku;
+
+	end = vaddr + PAGE_SIZE;
+	if (end > reg->rg_filebase + reg->rg_filesz) {
+		end = reg->rg_filebase + reg->rg_filesz;
+	}
+	if (end <= vaddr) {
+		return 0;
+	}
+
+	uio_kinit(&iov, &ku, (void *)PADDR_TO_KVADDR(pa), end - vaddr,
+		  reg->rg_fileoff + (vaddr - reg->rg_filebase), UIO_WRITE);
+	return VOP_WRITE(reg->rg_vnode, &ku);
+}
+
+int
+vm_writefilepage(struct vnode *vn, off_t off, paddr_t pa)
+{
+	struct stat st;
+	struct iovec iov;
+	struct uio ku;
+	size_t len;
+	int result;
+
+	/* only as much as the file has, so it never grows */
+	result = VOP_STAT(vn, &st);
+	if (result) {
+		return result;
+	}
+	if (off >= st.st_size) {
+		return 0;
+	}
+	len = PAGE_SIZE;
+	if (st.st_size - off < PAGE_SIZE) {
+		len = st.st_size - off;
+	}
+
+	uio_kinit(&iov, &ku, (void *)PADDR_TO_KVADDR(pa), len, off,
+		  UIO_WRITE);
+	return VOP_WRITE(vn, &ku);
+}
+
+int
+vm_syncpages(struct addrspace *as, struct region *reg, vaddr_t start,
+	     vaddr_t end, bool unmap)
+{
+	vaddr_t va;
+	pte_t *pte;
+	paddr_t pa;
+	bool dirty;
+	int result, err = 0;
+
+	KASSERT(unmap || reg->rg_mmap == MAP_SHARED);
+
+	lock_acquire(vm_lock);
+	for (va = start; va < end; va += PAGE_SIZE) {
+		pte = pt_lookup(as->as_pt, va, false);
+		if (pte == NULL) {
+			continue;
+		}
+		if (unmap && (*pte & PTE_BUSY)) {
+			/* a private page on its way to or from swap */
+			swap_wait(as);
+		}
+		if (*pte & PTE_SWAP) {
+			if (unmap) {
+				swap_freeslot(*pte);
+				*pte = 0;
+			}
+			continue;
+		}
+		if ((*pte & (PTE_VALID | PTE_IDLE)) == 0) {
+			continue;
+		}
+
+		pa = *pte & PTE_FRAME;
+		dirty = (*pte & (PTE_SHARED | PTE_WRITE)) ==
+			(PTE_SHARED | PTE_WRITE);
+		if (!dirty && !unmap) {
+			continue;
+		}
+		/* the next write marks it dirty again */
+		*pte = unmap ? 0 : *pte & ~PTE_WRITE;
+		vm_tlbinval(as, va);
+
+		if (dirty) {
+			/*
+			 * The file system may fault on user memory
+			 * with its own locks held, so write with none
+			 * of ours. The extra reference keeps the
+			 * pageout thread off the frame meanwhile.
+			 */
+			frame_incref(pa);
+			lock_release(vm_lock);
+			result = vm_writepage(reg, va, pa);
+			lock_acquire(vm_lock);
+			free_kpages(PADDR_TO_KVADDR(pa));
+			if (result && err == 0) {
+				err = result;
+			}
+		}
+		if (unmap) {
+			swap_freeframe(pa, as);
+		}
+	}
+	lock_release(vm_lock);
+	return err;
+}
+
+/*
+ * Fault-around: after the first touch of the page at VADDR in REG,
+ * map the untouched pages of REG in the window of vm_faultaround
+ * pages holding it that can be had without I/O or paging: file pages
+ * already in the page cache, and zero-filled ones while frames are
+ * plentiful. A sequential scan then faults once a window rather than
+ * once a page. Only the page table is filled in; utlb_refill loads
+ * the TLB when the pages are touched.
+ */
+static
+void
+vm_prefault(struct addrspace *as, struct region *reg, vaddr_t vaddr)
+{
+	unsigned window = vm_faultaround;
+	vaddr_t start, end, top, va;
+	pte_t *pte, bits;
+	paddr_t pa;
+
+	if (window <= 1) {
+		return;
+	}
+	start = vaddr & ~(vaddr_t)(window * PAGE_SIZE - 1);
+	end = start + window * PAGE_SIZE;
+	top = reg->rg_base + reg->rg_npages * PAGE_SIZE;
+	if (start < reg->rg_base) {
+		start = reg->rg_base;
+	}
+	if (end > top) {
+		end = top;
+	}
+
+	for (va = start; va < end; va += PAGE_SIZE) {
+		/* the window is inside VADDR's second-level table */
+		pte = pt_lookup(as->as_pt, va, false);
+		KASSERT(pte != NULL);
+		if (*pte != 0) {
+			/* VADDR, or touched already */
+			continue;
+		}
+
+		if (reg->rg_mmap != 0) {
+			pa = pagecache_get(reg->rg_vnode, PC_FILE,
+				reg->rg_fileoff + (va - reg->rg_base));
+			if (pa == 0) {
+				continue;
+			}
+			swap_setowner(pa, as, va);
+			bits = reg->rg_mmap == MAP_SHARED ? PTE_SHARED :
+				reg->rg_write ? PTE_COW : 0;
+		}
+		else if (reg->rg_vnode != NULL &&
+			 va < reg->rg_filebase + reg->rg_filesz &&
+			 va + PAGE_SIZE > reg->rg_filebase) {
+			/* some of it comes from the file */
+			if (reg->rg_write) {
+				continue;
+			}
+			pa = pagecache_get(reg->rg_vnode, PC_TEXT, va);
+			if (pa == 0) {
+				continue;
+			}
+			swap_setowner(pa, as, va);
+			bits = 0;
+		}
+		else {
+			pa = swap_tryframe(true);
+			if (pa == 0) {
+				/* memory is getting short */
+				break;
+			}
+			swap_setowner(pa, as, va);
+			bits = reg->rg_write ? PTE_WRITE : 0;
+		}
+		*pte = pa | PTE_VALID | bits;
+		curproc->p_prefault++;
+	}
+}
+
+int
+vm_fault(int faulttype, vaddr_t faultaddress)
+{
+	struct addrspace *as;
+	struct region *reg;
+	pte_t *pte;
+	paddr_t pa;
+	off_t off;
+	bool major = false, first = false;
+	int result;
+
+	faultaddress &= PAGE_FRAME;
+
+	DEBUG(DB_VM, "vm: fault: 0x%x\n", faultaddress);
+
+	switch (faulttype) {
+	    case VM_FAULT_READONLY:
+	    case VM_FAULT_READ:
+	    case VM_FAULT_WRITE:
+		break;
+	    default:
+		return EINVAL;
+	}
+
+	if (curproc == NULL) {
+		/*
+		 * No process. This is probably a kernel fault early
+		 * in boot. Return EFAULT so as to panic instead of
+		 * getting into an infinite faulting loop.
+		 */
+		return EFAULT;
+	}
+
+	as = proc_getas();
+	if (as == NULL) {
+		/*
+		 * No address space set up. This is probably also a
+		 * kernel fault early in boot.
+		 */
+		return EFAULT;
+	}
+
+	/* racy, but only ever read for the stats */
+	vm_tlbcpus[curcpu->c_number].tc_faults++;
+
+	reg = as_find_region(as, faultaddress);
+	if (reg == NULL) {
+		/* maybe the stack growing */
+		reg = as_grow_stack(as, faultaddress);
+		if (reg == NULL) {
+			return EFAULT;
+		}
+	}
+	/* pages of read-only regions are mapped read-only */
+	if (faulttype != VM_FAULT_READ && !reg->rg_write) {
+		return EFAULT;
+	}
+
+	lock_acquire(vm_lock);
+
+	pte = pt_lookup(as->as_pt, faultaddress, true);
+	if (pte == NULL) {
+		lock_release(vm_lock);
+		return ENOMEM;
+	}
+again:
+	if (*pte & (PTE_SWAP | PTE_BUSY)) {
+		major = true;
+		result = swap_pagein(as, faultaddress, pte);
+		if (result) {
+			lock_release(vm_lock);
+			return result;
+		}
+	}
+	if (*pte & PTE_IDLE) {
+		/* still in use after all */
+		*pte = (*pte & ~PTE_IDLE) | PTE_VALID;
+	}
+	else if ((*pte & PTE_VALID) == 0) {
+		/* first touch */
+		first = true;
+		pa = 0;
+		if (reg->rg_mmap != 0) {
+			off = reg->rg_fileoff + (faultaddress - reg->rg_base);
+			pa = pagecache_get(reg->rg_vnode, PC_FILE, off);
+			if (pa == 0) {
+				major = true;
+				result = vm_mappage(reg, off, &pa);
+				if (result) {
+					lock_release(vm_lock);
+					return result;
+				}
+			}
+			swap_setowner(pa, as, faultaddress);
+			*pte = pa | PTE_VALID;
+			if (reg->rg_mmap == MAP_SHARED) {
+				*pte |= PTE_SHARED;
+			}
+			else if (reg->rg_write) {
+				*pte |= PTE_COW;
+			}
+		}
+		else {
+			if (reg->rg_vnode != NULL && !reg->rg_write) {
+				/* text another process may have read in */
+				pa = pagecache_get(reg->rg_vnode, PC_TEXT,
+						   faultaddress);
+				if (pa != 0) {
+					swap_setowner(pa, as, faultaddress);
+				}
+			}
+			if (pa == 0) {
+				/* BSS pages need no I/O, so are minor */
+				result = vm_newpage(as, reg, faultaddress,
+						    &pa, &major);
+				if (result) {
+					lock_release(vm_lock);
+					return result;
+				}
+			}
+			*pte = pa | PTE_VALID;
+			if (reg->rg_write) {
+				*pte |= PTE_WRITE;
+			}
+		}
+	}
+	if (faulttype != VM_FAULT_READ && (*pte & PTE_SHARED)) {
+		/* first write since mapped or synced: now dirty */
+		*pte |= PTE_WRITE;
+	}
+	if (faulttype != VM_FAULT_READ && (*pte & PTE_COW)) {
+		result = vm_cowbreak(as, faultaddress, pte);
+		if (result == EAGAIN) {
+			goto again;
+		}
+		if (result) {
+			lock_release(vm_lock);
+			return result;
+		}
+	}
+
+	vm_tlbload(faultaddress, *pte);
+
+	if (first) {
+		vm_prefault(as, reg, faultaddress);
+	}
+
+	/* only this process's own thread counts its faults */
+	if (major) {
+		curproc->p_majflt++;
+	}
+	else {
+		curproc->p_minflt++;
+	}
+
+	lock_release(vm_lock);
+	return 0;
+}
@@ -28,6 +28,7 @@
  */
 
 #include <unistd.h>
+#include <errno.h>
 #include <err.h>
 
 /*
@@ -35,6 +36,9 @@
  * Usage: cp oldfile newfile
  */
 
+/* bytes per copy_file_range call */
+#define COPYCHUNK (1024*1024)
+
 
 /* Copy one file to another. */
 static
@@ -45,6 +49,7 @@ copy(const char *from, const char *to)
 	int tofd;
 	char buf[1024];
 	int len, wr, wrtot;
+	int copied = 0;
 
 	/*
 	 * Open the files, and give up if they won't open
@@ -58,6 +63,22 @@ copy(const char *from, const char *to)
 		err(1, "%s", to);
 	}
 
+	/*
+	 * Let the kernel move the data file to file. Zero means EOF.
+	 * If the call isn't there (or won't handle these files) and
+	 * nothing has been copied yet, fall back to doing it by hand.
+	 */
+	while ((len = copy_file_range(fromfd, NULL, tofd, NULL,
+				      COPYCHUNK, 0)) > 0) {
+		copied = 1;
+	}
+	if (len == 0) {
+		goto done;
+	}
+	if (copied || (errno != ENOSYS && errno != EINVAL)) {
+		err(1, "%s to %s", from, to);
+	}
+
 	/*
 	 * As long as we get more than zero bytes, we haven't hit EOF.
 	 * Zero means EOF. Less than zero means an error occurred.
@@ -85,6 +106,7 @@ copy(const char *from, const char *to)
 		err(1, "%s", from);
 	}
 
+ done:
 	if (close(fromfd) < 0) {
 		err(1, "%s: close", from);
 	}
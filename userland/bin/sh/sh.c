@@ -69,6 +69,9 @@ struct exitinfo {
 /* set to nonzero if __time syscall seems to work */
 static int timing = 0;
 
+/* most commands in one pipeline */
+#define MAXPIPE 16
+
 /* array of backgrounded jobs (allows "foregrounding") */
 #define MAXBG 128
 static pid_t bgpids[MAXBG];
@@ -355,10 +358,145 @@ static struct {
 	{ NULL, NULL }
 };
 
+/*
+ * printtime
+ * reports how long it has been since a command was started.
+ */
+static
+void
+printtime(time_t startsecs, unsigned long startnsecs)
+{
+	time_t endsecs;
+	unsigned long endnsecs;
+
+	__time(&endsecs, &endnsecs);
+	if (endnsecs < startnsecs) {
+		endnsecs += 1000000000;
+		endsecs--;
+	}
+	endnsecs -= startnsecs;
+	endsecs -= startsecs;
+	warnx("subprocess time: %lu.%09lu seconds",
+	      (unsigned long) endsecs, (unsigned long) endnsecs);
+}
+
+/*
+ * dopipeline
+ * runs "a | b | c". each stage is forked with its stdout connected
+ * to the next stage's stdin. args is the whole tokenized command line
+ * and is chopped up in place at the "|" tokens. the exit status is
+ * that of the last stage, as in other shells.
+ */
+static
+void
+dopipeline(char **args, int nargs, struct exitinfo *ei)
+{
+	char **stages[MAXPIPE];
+	pid_t pids[MAXPIPE];
+	int nstages, infd, fds[2];
+	int i, status;
+	time_t startsecs;
+	unsigned long startnsecs;
+
+	nstages = 0;
+	stages[nstages++] = args;
+	for (i=0; i<nargs; i++) {
+		if (strcmp(args[i], "|") != 0) {
+			continue;
+		}
+		if (nstages >= MAXPIPE) {
+			printf("Too many pipeline stages (max %d)\n",
+			       MAXPIPE);
+			exitinfo_exit(ei, 1);
+			return;
+		}
+		args[i] = NULL;
+		stages[nstages++] = &args[i+1];
+	}
+	for (i=0; i<nstages; i++) {
+		if (stages[i][0] == NULL) {
+			printf("Empty command in pipeline\n");
+			exitinfo_exit(ei, 1);
+			return;
+		}
+	}
+
+	if (timing) {
+		__time(&startsecs, &startnsecs);
+	}
+
+	/* infd is the read end of the previous stage's pipe, if any */
+	infd = -1;
+	for (i=0; i<nstages; i++) {
+		fds[0] = fds[1] = -1;
+		if (i < nstages-1 && pipe(fds) < 0) {
+			warn("pipe");
+			break;
+		}
+
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			warn("fork");
+			if (fds[0] >= 0) {
+				close(fds[0]);
+				close(fds[1]);
+			}
+			break;
+		}
+		if (pids[i] == 0) {
+			/* child */
+			if (infd >= 0) {
+				dup2(infd, STDIN_FILENO);
+				close(infd);
+			}
+			if (fds[1] >= 0) {
+				dup2(fds[1], STDOUT_FILENO);
+				close(fds[1]);
+				close(fds[0]);
+			}
+			execvp(stages[i][0], stages[i]);
+			warn("%s", stages[i][0]);
+			_exit(1);
+		}
+
+		/* parent: keep only what the next stage needs */
+		if (infd >= 0) {
+			close(infd);
+		}
+		if (fds[1] >= 0) {
+			close(fds[1]);
+		}
+		infd = fds[0];
+	}
+	if (infd >= 0) {
+		close(infd);
+	}
+
+	if (i < nstages) {
+		/* setup failed partway; reap what did start */
+		nstages = i;
+		exitinfo_exit(ei, 255);
+	}
+	for (i=0; i<nstages; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			warn("waitpid");
+			exitinfo_exit(ei, 255);
+		}
+		else if (i == nstages-1) {
+			readstatus(status, ei);
+		}
+	}
+
+	if (timing) {
+		printtime(startsecs, startnsecs);
+	}
+}
+
 /*
  * docommand
  * tokenizes the command line using strtok.  if there aren't any commands,
  * simply returns.  checks to see if it's a builtin, running it if it is.
+ * a line containing "|" is run as a pipeline instead.
  * otherwise, it's a standard command.  check for the '&', try to background
  * the job if possible, otherwise just run it and wait on it.
  */
@@ -372,8 +510,8 @@ docommand(char *buf, struct exitinfo *ei)
 	pid_t pid;
 	int status;
 	int bg=0;
-	time_t startsecs, endsecs;
-	unsigned long startnsecs, endnsecs;
+	time_t startsecs;
+	unsigned long startnsecs;
 
 	nargs = 0;
 	for (s = strtok(buf, " \t\r\n"); s; s = strtok(NULL, " \t\r\n")) {
@@ -394,6 +532,19 @@ docommand(char *buf, struct exitinfo *ei)
 		return;
 	}
 
+	for (i=0; i<nargs; i++) {
+		if (!strcmp(args[i], "|")) {
+			if (!strcmp(args[nargs-1], "&")) {
+				printf("Pipelines cannot be run in the "
+				       "background\n");
+				exitinfo_exit(ei, 1);
+				return;
+			}
+			dopipeline(args, nargs, ei);
+			return;
+		}
+	}
+
 	for (i=0; builtins[i].name; i++) {
 		if (!strcmp(builtins[i].name, args[0])) {
 			builtins[i].func(nargs, args, ei);
@@ -462,15 +613,7 @@ docommand(char *buf, struct exitinfo *ei)
 	}
 
 	if (timing) {
-		__time(&endsecs, &endnsecs);
-		if (endnsecs < startnsecs) {
-			endnsecs += 1000000000;
-			endsecs--;
-		}
-		endnsecs -= startnsecs;
-		endsecs -= startsecs;
-		warnx("subprocess time: %lu.%09lu seconds",
-		      (unsigned long) endsecs, (unsigned long) endnsecs);
+		printtime(startsecs, startnsecs);
 	}
 }
 
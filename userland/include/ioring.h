@@ -0,0 +1,45 @@
+#ifndef _IORING_H_
+#define _IORING_H_
+
+#include <sys/types.h>
+#include <kern/ioring.h>
+
+/*
+ * Helpers for the batched I/O ring (see <kern/ioring.h>).
+ *
+ * The caller provides IORING_SIZE(entries) bytes of 8-byte-aligned
+ * memory and registers it with ioring_init(). Requests are queued
+ * with ioring_get_sqe() and one of the prep functions, then run with
+ * one trap by ioring_submit(). Completions are reaped from memory
+ * with ioring_peek_cqe()/ioring_cqe_seen(), which never trap.
+ *
+ *    ioring_init     - register RING of ENTRIES slots with the kernel.
+ *    ioring_get_sqe  - next free submission slot, or NULL if the
+ *                      submission ring is full.
+ *    ioring_submit   - hand all queued requests to the kernel.
+ *                      Returns how many were run, or -1 and errno.
+ *    ioring_peek_cqe - oldest unreaped completion, or NULL.
+ *    ioring_cqe_seen - release the completion from ioring_peek_cqe.
+ */
+
+int ioring_init(struct ioring *ring, unsigned entries);
+struct ioring_sqe *ioring_get_sqe(struct ioring *ring);
+int ioring_submit(struct ioring *ring);
+struct ioring_cqe *ioring_peek_cqe(struct ioring *ring);
+void ioring_cqe_seen(struct ioring *ring);
+
+void ioring_prep_read(struct ioring_sqe *sqe, int fd, void *buf,
+		      size_t len, __u32 data);
+void ioring_prep_write(struct ioring_sqe *sqe, int fd, const void *buf,
+		       size_t len, __u32 data);
+void ioring_prep_pread(struct ioring_sqe *sqe, int fd, void *buf,
+		       size_t len, off_t pos, __u32 data);
+void ioring_prep_pwrite(struct ioring_sqe *sqe, int fd, const void *buf,
+			size_t len, off_t pos, __u32 data);
+void ioring_prep_lseek(struct ioring_sqe *sqe, int fd, off_t pos,
+		       int whence, __u32 data);
+void ioring_prep_open(struct ioring_sqe *sqe, const char *path, int flags,
+		      __u32 data);
+void ioring_prep_close(struct ioring_sqe *sqe, int fd, __u32 data);
+
+#endif /* _IORING_H_ */
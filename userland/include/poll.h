@@ -0,0 +1,17 @@
+#ifndef _POLL_H_
+#define _POLL_H_
+
+#include <sys/types.h>
+
+/*
+ * Get struct pollfd and the POLL* bits from the kernel.
+ */
+#include <kern/poll.h>
+
+/*
+ * Wait until one of the conditions asked for holds on one of the
+ * descriptors, or TIMEOUT milliseconds pass (negative: forever).
+ */
+int poll(struct pollfd *fds, nfds_t nfds, int timeout);
+
+#endif /* _POLL_H_ */
@@ -0,0 +1,22 @@
+#ifndef _SYS_MMAN_H_
+#define _SYS_MMAN_H_
+
+#include <sys/types.h>
+
+/*
+ * Get the PROT_*, MAP_* and MS_* constants from the kernel.
+ */
+#include <kern/mman.h>
+
+/*
+ * Map LEN bytes of the file open on FD, from OFFSET (a multiple of
+ * the page size) on, into memory. Pages are read in as they are
+ * touched. With MAP_SHARED, writes to the mapping are written back
+ * to the file by msync and munmap, and are seen by every other
+ * process mapping the file shared; with MAP_PRIVATE they are not.
+ */
+void *mmap(void *addr, size_t len, int prot, int flags, int fd, off_t offset);
+int munmap(void *addr, size_t len);
+int msync(void *addr, size_t len, int flags);
+
+#endif /* _SYS_MMAN_H_ */
@@ -0,0 +1,27 @@
+#ifndef _SYS_RESOURCE_H_
+#define _SYS_RESOURCE_H_
+
+#include <sys/types.h>
+
+/*
+ * Get struct rusage and the RUSAGE_* and RLIMIT_* constants from the
+ * kernel.
+ */
+#include <kern/time.h>
+#include <kern/resource.h>
+
+/*
+ * Resource usage of this process, or of its children. Only the page
+ * fault counts, ru_minflt and ru_majflt, and ru_prefault, the pages
+ * mapped around faults before they were touched, are kept.
+ */
+int getrusage(int who, struct rusage *usage);
+
+/*
+ * Resource limits. Only RLIMIT_STACK, how far the stack may grow,
+ * can be set, and then only its soft limit, rlim_cur.
+ */
+int getrlimit(int resource, struct rlimit *rlp);
+int setrlimit(int resource, const struct rlimit *rlp);
+
+#endif /* _SYS_RESOURCE_H_ */
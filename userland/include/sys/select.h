@@ -0,0 +1,19 @@
+#ifndef _SYS_SELECT_H_
+#define _SYS_SELECT_H_
+
+#include <sys/types.h>
+
+/*
+ * Get fd_set and the FD_* macros from the kernel.
+ */
+#include <kern/time.h>
+#include <kern/select.h>
+
+/*
+ * Same as poll, in the older interface: on return each set holds
+ * the descriptors that are ready. A NULL timeout waits forever.
+ */
+int select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds,
+	   struct timeval *timeout);
+
+#endif /* _SYS_SELECT_H_ */
@@ -39,6 +39,7 @@
  * about the kern/ headers.
  */
 #include <kern/fcntl.h>
+#include <kern/iovec.h>
 #include <kern/ioctl.h>
 #include <kern/reboot.h>
 #include <kern/seek.h>
@@ -57,6 +58,8 @@
  *     fstat:    sys/stat.h
  *     lstat:    sys/stat.h
  *     mkdir:    sys/stat.h
+ *     poll:     poll.h
+ *     select:   sys/select.h
  *
  * If this were standard Unix, more prototypes would go in other
  * header files as well, as follows:
@@ -145,9 +148,22 @@ ssize_t getdirentry(int filehandle, char *buf, size_t buflen);
 int symlink(const char *target, const char *linkname);
 ssize_t readlink(const char *path, char *buf, size_t buflen);
 int dup2(int filehandle, int newhandle);
+ssize_t pread(int filehandle, void *buf, size_t size, off_t pos);
+ssize_t pwrite(int filehandle, const void *buf, size_t size, off_t pos);
+ssize_t readv(int filehandle, const struct iovec *iov, int iovcnt);
+ssize_t writev(int filehandle, const struct iovec *iov, int iovcnt);
+ssize_t preadv(int filehandle, const struct iovec *iov, int iovcnt, off_t pos);
+ssize_t pwritev(int filehandle, const struct iovec *iov, int iovcnt,
+		off_t pos);
 int pipe(int filehandles[2]);
 int __time(time_t *seconds, unsigned long *nanoseconds);
 ssize_t __getcwd(char *buf, size_t buflen);
+/* batched I/O ring - see <ioring.h> for the helpers */
+struct ioring;
+int ioring_setup(struct ioring *ring, unsigned entries);
+int ioring_enter(unsigned to_submit);
+ssize_t copy_file_range(int infd, off_t *inpos, int outfd, off_t *outpos,
+			size_t len, unsigned flags);
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
@@ -0,0 +1,141 @@
+/*
+ * Userlevel side of the batched I/O ring. See <ioring.h>.
+ *
+ * Only ioring_init() and ioring_submit() trap; everything else just
+ * reads and writes the shared ring in our own memory.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <ioring.h>
+
+static
+struct ioring_sqe *
+sq(struct ioring *ring)
+{
+	return (struct ioring_sqe *)((char *)ring + IORING_SQ_OFFSET);
+}
+
+static
+struct ioring_cqe *
+cq(struct ioring *ring)
+{
+	return (struct ioring_cqe *)
+		((char *)ring + IORING_CQ_OFFSET(ring->ir_entries));
+}
+
+int
+ioring_init(struct ioring *ring, unsigned entries)
+{
+	/* the kernel fills in the header */
+	return ioring_setup(ring, entries);
+}
+
+struct ioring_sqe *
+ioring_get_sqe(struct ioring *ring)
+{
+	struct ioring_sqe *sqe;
+
+	if (ring->ir_sq_tail - ring->ir_sq_head == ring->ir_entries) {
+		return NULL;
+	}
+	sqe = &sq(ring)[ring->ir_sq_tail & (ring->ir_entries - 1)];
+	bzero(sqe, sizeof(*sqe));
+	ring->ir_sq_tail++;
+	return sqe;
+}
+
+int
+ioring_submit(struct ioring *ring)
+{
+	unsigned queued = ring->ir_sq_tail - ring->ir_sq_head;
+
+	if (queued == 0) {
+		return 0;
+	}
+	return ioring_enter(queued);
+}
+
+struct ioring_cqe *
+ioring_peek_cqe(struct ioring *ring)
+{
+	if (ring->ir_cq_head == ring->ir_cq_tail) {
+		return NULL;
+	}
+	return &cq(ring)[ring->ir_cq_head & (ring->ir_entries - 1)];
+}
+
+void
+ioring_cqe_seen(struct ioring *ring)
+{
+	ring->ir_cq_head++;
+}
+
+void
+ioring_prep_read(struct ioring_sqe *sqe, int fd, void *buf,
+		 size_t len, __u32 data)
+{
+	sqe->sqe_op = IORING_OP_READ;
+	sqe->sqe_fd = fd;
+	sqe->sqe_addr = (__u32)buf;
+	sqe->sqe_len = len;
+	sqe->sqe_data = data;
+}
+
+void
+ioring_prep_write(struct ioring_sqe *sqe, int fd, const void *buf,
+		  size_t len, __u32 data)
+{
+	sqe->sqe_op = IORING_OP_WRITE;
+	sqe->sqe_fd = fd;
+	sqe->sqe_addr = (__u32)buf;
+	sqe->sqe_len = len;
+	sqe->sqe_data = data;
+}
+
+void
+ioring_prep_pread(struct ioring_sqe *sqe, int fd, void *buf,
+		  size_t len, off_t pos, __u32 data)
+{
+	ioring_prep_read(sqe, fd, buf, len, data);
+	sqe->sqe_flags = IORING_F_POS;
+	sqe->sqe_off = pos;
+}
+
+void
+ioring_prep_pwrite(struct ioring_sqe *sqe, int fd, const void *buf,
+		   size_t len, off_t pos, __u32 data)
+{
+	ioring_prep_write(sqe, fd, buf, len, data);
+	sqe->sqe_flags = IORING_F_POS;
+	sqe->sqe_off = pos;
+}
+
+void
+ioring_prep_lseek(struct ioring_sqe *sqe, int fd, off_t pos,
+		  int whence, __u32 data)
+{
+	sqe->sqe_op = IORING_OP_LSEEK;
+	sqe->sqe_fd = fd;
+	sqe->sqe_off = pos;
+	sqe->sqe_flags = whence;
+	sqe->sqe_data = data;
+}
+
+void
+ioring_prep_open(struct ioring_sqe *sqe, const char *path, int flags,
+		 __u32 data)
+{
+	sqe->sqe_op = IORING_OP_OPEN;
+	sqe->sqe_addr = (__u32)path;
+	sqe->sqe_len = flags;
+	sqe->sqe_data = data;
+}
+
+void
+ioring_prep_close(struct ioring_sqe *sqe, int fd, __u32 data)
+{
+	sqe->sqe_op = IORING_OP_CLOSE;
+	sqe->sqe_fd = fd;
+	sqe->sqe_data = data;
+}
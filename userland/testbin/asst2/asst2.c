@@ -10,6 +10,7 @@
 #define MAX_BUF 500
 char teststr[] = "The quick brown fox jumped over the lazy dog.";
 char buf[MAX_BUF];
+struct iovec iov[2];
 
 int
 main(int argc, char * argv[])
@@ -119,9 +120,76 @@ main(int argc, char * argv[])
         } while (k < 5);
 
         printf("* file lseek  okay\n");
+
+        printf("**********\n* testing pread\n");
+        r = pread(fd, buf, 10, 5);
+        printf("* pread %d bytes\n", r);
+        if (r != 10) {
+                printf("ERROR pread: %s\n", strerror(errno));
+                exit(1);
+        }
+        for (k = 0; k < 10; k++) {
+                if (buf[k] != teststr[k + 5]) {
+                        printf("ERROR  file contents mismatch\n");
+                        exit(1);
+                }
+        }
+        /* pread must not have moved the seek position (5 + 10) */
+        r = lseek(fd, 0, SEEK_CUR);
+        if (r != 15) {
+                printf("ERROR pread moved offset to %d\n", r);
+                exit(1);
+        }
+        printf("* file pread  okay\n");
         printf("* closing file\n");
         close(fd);
 
+        printf("**********\n* testing writev\n");
+        fd = open("test.file", O_RDWR | O_TRUNC);
+        if (fd < 0) {
+                printf("ERROR opening file: %s\n", strerror(errno));
+                exit(1);
+        }
+        iov[0].iov_base = teststr;
+        iov[0].iov_len = 4;
+        iov[1].iov_base = teststr + 4;
+        iov[1].iov_len = strlen(teststr) - 4;
+        r = writev(fd, iov, 2);
+        printf("* writev wrote %d bytes\n", r);
+        if (r != (int)strlen(teststr)) {
+                printf("ERROR writev: %s\n", strerror(errno));
+                exit(1);
+        }
+        r = pread(fd, buf, MAX_BUF, 0);
+        if (r != (int)strlen(teststr) || memcmp(buf, teststr, r) != 0) {
+                printf("ERROR  file contents mismatch\n");
+                exit(1);
+        }
+        printf("* file writev okay\n");
+
+        printf("**********\n* testing copy_file_range\n");
+        j = open("test.copy", O_RDWR | O_CREAT | O_TRUNC);
+        if (j < 0) {
+                printf("ERROR opening file: %s\n", strerror(errno));
+                exit(1);
+        }
+        lseek(fd, 4, SEEK_SET);
+        r = copy_file_range(fd, NULL, j, NULL, MAX_BUF, 0);
+        printf("* copy_file_range copied %d bytes\n", r);
+        if (r != (int)strlen(teststr) - 4) {
+                printf("ERROR copy_file_range: %s\n", strerror(errno));
+                exit(1);
+        }
+        r = pread(j, buf, MAX_BUF, 0);
+        if (r != (int)strlen(teststr) - 4 ||
+            memcmp(buf, teststr + 4, r) != 0) {
+                printf("ERROR  file contents mismatch\n");
+                exit(1);
+        }
+        printf("* file copy_file_range okay\n");
+        close(j);
+        close(fd);
+
         return 0;
 }
 
@@ -0,0 +1,197 @@
+/*
+ * cowtest - check that fork's copy-on-write pages really get copied.
+ *
+ * Sets up three pages before forking: one on the heap, one on the
+ * stack, and a second heap page that is then pushed out to swap by
+ * touching COLDMB megabytes of other memory; an optional argument
+ * overrides that, and it should be more than the machine's RAM so the
+ * page is surely on swap when fork copies the page table.
+ *
+ * After the fork, the child writes its own pattern over all three
+ * pages, then the parent writes its own. Each checks that it saw the
+ * pre-fork contents first and only its own pattern after.
+ *
+ * The two step each other along over pipes, and the child sends its
+ * verdict back over one before it exits.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define PAGE		4096
+#define COLDMB		8
+
+#define BEFORE		1
+#define CHILD		2
+#define PARENT		3
+
+/* fill a page with a pattern that depends on who wrote it */
+static
+void
+fill(volatile unsigned char *p, unsigned who)
+{
+	unsigned i;
+
+	for (i = 0; i < PAGE; i++) {
+		p[i] = (unsigned char)(who * 37 + i);
+	}
+}
+
+/* true if the page holds WHO's pattern */
+static
+int
+check(volatile unsigned char *p, unsigned who)
+{
+	unsigned i;
+
+	for (i = 0; i < PAGE; i++) {
+		if (p[i] != (unsigned char)(who * 37 + i)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static
+void
+sendbyte(int fd, char c)
+{
+	if (write(fd, &c, 1) != 1) {
+		err(1, "write");
+	}
+}
+
+static
+char
+recvbyte(int fd)
+{
+	char c;
+
+	if (read(fd, &c, 1) != 1) {
+		err(1, "read");
+	}
+	return c;
+}
+
+/* touch MB megabytes of fresh heap, to push older pages out */
+static
+void
+pushout(unsigned mb)
+{
+	volatile unsigned char *p;
+	unsigned i, npages;
+
+	npages = mb * (1024 * 1024 / PAGE);
+	p = sbrk(npages * PAGE);
+	if (p == (void *)-1) {
+		err(1, "sbrk");
+	}
+	for (i = 0; i < npages; i++) {
+		p[i * PAGE] = (unsigned char)i;
+	}
+}
+
+static
+void
+child(volatile unsigned char *heap, volatile unsigned char *stack,
+      volatile unsigned char *cold, int tochild, int toparent)
+{
+	char ok = 'y';
+
+	if (!check(heap, BEFORE) || !check(stack, BEFORE) ||
+	    !check(cold, BEFORE)) {
+		ok = 'b';
+	}
+	fill(heap, CHILD);
+	fill(stack, CHILD);
+	fill(cold, CHILD);
+	sendbyte(toparent, 'w');
+
+	/* now the parent writes its own */
+	recvbyte(tochild);
+	if (ok == 'y' && (!check(heap, CHILD) || !check(stack, CHILD) ||
+			  !check(cold, CHILD))) {
+		ok = 'o';
+	}
+	sendbyte(toparent, ok);
+	_exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	volatile unsigned char stack[PAGE];
+	volatile unsigned char *heap, *cold;
+	unsigned mb;
+	int tochild[2], toparent[2];
+	pid_t pid;
+	int status;
+	char ok;
+
+	mb = COLDMB;
+	if (argc > 1) {
+		mb = atoi(argv[1]);
+	}
+
+	heap = sbrk(2 * PAGE);
+	if (heap == (void *)-1) {
+		err(1, "sbrk");
+	}
+	cold = heap + PAGE;
+	fill(heap, BEFORE);
+	fill(stack, BEFORE);
+	fill(cold, BEFORE);
+	pushout(mb);
+
+	if (pipe(tochild) < 0 || pipe(toparent) < 0) {
+		err(1, "pipe");
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		child(heap, stack, cold, tochild[0], toparent[1]);
+	}
+
+	/* let the child write first */
+	if (recvbyte(toparent[0]) != 'w') {
+		errx(1, "child out of step");
+	}
+
+	if (!check(cold, BEFORE)) {
+		errx(1, "parent sees the child's write to the swapped page");
+	}
+	if (!check(heap, BEFORE)) {
+		errx(1, "parent sees the child's write to the heap page");
+	}
+	if (!check(stack, BEFORE)) {
+		errx(1, "parent sees the child's write to the stack page");
+	}
+	fill(heap, PARENT);
+	fill(stack, PARENT);
+	fill(cold, PARENT);
+	sendbyte(tochild[1], 'p');
+
+	ok = recvbyte(toparent[0]);
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (ok == 'b') {
+		errx(1, "child did not see the pre-fork contents");
+	}
+	if (ok != 'y') {
+		errx(1, "child sees the parent's writes");
+	}
+	if (!check(heap, PARENT) || !check(stack, PARENT) ||
+	    !check(cold, PARENT)) {
+		errx(1, "parent sees the child's writes");
+	}
+	printf("cowtest: passed\n");
+	return 0;
+}
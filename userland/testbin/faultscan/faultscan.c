@@ -0,0 +1,67 @@
+/*
+ * faultscan - count the page faults a sequential scan takes.
+ *
+ * Grows the heap by NPAGES pages and writes one word in each page
+ * in order, then reads them back, and reports how many page faults
+ * each pass took and how many pages the kernel mapped ahead of use
+ * (fault-around). With fault-around on, the first pass should take
+ * well under one fault a page; the second should take none.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <err.h>
+
+#define PAGE		4096
+#define NPAGES		1024	/* 4M */
+
+static
+void
+usage(struct rusage *ru)
+{
+	if (getrusage(RUSAGE_SELF, ru) < 0) {
+		err(1, "getrusage");
+	}
+}
+
+int
+main(void)
+{
+	struct rusage ru0, ru1, ru2;
+	volatile unsigned *p;
+	unsigned long faults, ahead;
+	unsigned i;
+
+	p = sbrk(NPAGES * PAGE);
+	if (p == (void *)-1) {
+		err(1, "sbrk");
+	}
+
+	usage(&ru0);
+	for (i = 0; i < NPAGES; i++) {
+		p[i * PAGE / sizeof(*p)] = i;
+	}
+	usage(&ru1);
+	for (i = 0; i < NPAGES; i++) {
+		if (p[i * PAGE / sizeof(*p)] != i) {
+			errx(1, "page %u: read %u", i,
+			     p[i * PAGE / sizeof(*p)]);
+		}
+	}
+	usage(&ru2);
+
+	faults = ru1.ru_minflt + ru1.ru_majflt -
+		ru0.ru_minflt - ru0.ru_majflt;
+	ahead = ru1.ru_prefault - ru0.ru_prefault;
+	printf("faultscan: writing %u pages took %lu faults, "
+	       "%lu pages mapped ahead\n", NPAGES, faults, ahead);
+	printf("faultscan: reading them back took %lu faults\n",
+	       (unsigned long)(ru2.ru_minflt + ru2.ru_majflt -
+			       ru1.ru_minflt - ru1.ru_majflt));
+
+	if (faults + ahead < NPAGES) {
+		errx(1, "fewer faults than pages touched");
+	}
+	return 0;
+}
@@ -0,0 +1,215 @@
+/*
+ * ioringbench - compare small I/O through plain read()/write() loops
+ * with the same I/O batched through the submission ring.
+ *
+ * Writes NCHUNKS chunks of CHUNKSIZE bytes to a scratch file one
+ * syscall at a time, then again with up to RINGSIZE requests per
+ * ioring_enter(); then reads the file back both ways and checks the
+ * data. Prints the elapsed time and per-chunk cost of each pass.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+#include <errno.h>
+#include <ioring.h>
+
+#define FILENAME	"ioringbench.tmp"
+#define CHUNKSIZE	64
+#define NCHUNKS		4096
+#define RINGSIZE	64
+
+/* ring memory must be 8-byte aligned */
+static union {
+	__i64 align;
+	char mem[IORING_SIZE(RINGSIZE)];
+} ringmem;
+
+static char chunks[NCHUNKS][CHUNKSIZE];
+static char readback[NCHUNKS][CHUNKSIZE];
+
+struct stamp {
+	time_t secs;
+	unsigned long nsecs;
+};
+
+static
+void
+now(struct stamp *s)
+{
+	__time(&s->secs, &s->nsecs);
+}
+
+static
+void
+report(const char *what, const struct stamp *start, const struct stamp *end)
+{
+	unsigned long long ns;
+
+	ns = (end->secs - start->secs) * 1000000000ULL;
+	ns += end->nsecs;
+	ns -= start->nsecs;
+	printf("%-14s %lu.%09lu s  %lu ns/chunk\n", what,
+	       (unsigned long)(ns / 1000000000ULL),
+	       (unsigned long)(ns % 1000000000ULL),
+	       (unsigned long)(ns / NCHUNKS));
+}
+
+static
+void
+fill(void)
+{
+	int i, j;
+
+	for (i = 0; i < NCHUNKS; i++) {
+		for (j = 0; j < CHUNKSIZE; j++) {
+			chunks[i][j] = 'a' + (i + j) % 26;
+		}
+	}
+}
+
+static
+void
+check(const char *what)
+{
+	if (memcmp(chunks, readback, sizeof(chunks)) != 0) {
+		errx(1, "%s: data mismatch", what);
+	}
+	bzero(readback, sizeof(readback));
+}
+
+static
+int
+openfile(int flags)
+{
+	int fd;
+
+	fd = open(FILENAME, flags, 0664);
+	if (fd < 0) {
+		err(1, "%s", FILENAME);
+	}
+	return fd;
+}
+
+/* reap everything the last submit produced, checking each result */
+static
+void
+reap(struct ioring *ring, const char *what)
+{
+	struct ioring_cqe *cqe;
+
+	while ((cqe = ioring_peek_cqe(ring)) != NULL) {
+		if (cqe->cqe_res < 0) {
+			errno = -cqe->cqe_res;
+			err(1, "%s: chunk %u", what, cqe->cqe_data);
+		}
+		if (cqe->cqe_res != CHUNKSIZE) {
+			errx(1, "%s: chunk %u: short transfer", what,
+			     cqe->cqe_data);
+		}
+		ioring_cqe_seen(ring);
+	}
+}
+
+/*
+ * Queue one request per chunk, submitting whenever the ring fills
+ * and once more at the end.
+ */
+static
+void
+ringpass(struct ioring *ring, int fd, int dowrite, const char *what)
+{
+	struct ioring_sqe *sqe;
+	int i;
+
+	for (i = 0; i < NCHUNKS; i++) {
+		sqe = ioring_get_sqe(ring);
+		if (sqe == NULL) {
+			if (ioring_submit(ring) < 0) {
+				err(1, "%s: ioring_enter", what);
+			}
+			reap(ring, what);
+			sqe = ioring_get_sqe(ring);
+		}
+		if (dowrite) {
+			ioring_prep_pwrite(sqe, fd, chunks[i], CHUNKSIZE,
+					   (off_t)i * CHUNKSIZE, i);
+		}
+		else {
+			ioring_prep_pread(sqe, fd, readback[i], CHUNKSIZE,
+					  (off_t)i * CHUNKSIZE, i);
+		}
+	}
+	if (ioring_submit(ring) < 0) {
+		err(1, "%s: ioring_enter", what);
+	}
+	reap(ring, what);
+}
+
+int
+main(void)
+{
+	struct ioring *ring = (struct ioring *)ringmem.mem;
+	struct stamp start, end;
+	ssize_t r;
+	int fd, i;
+
+	fill();
+	if (ioring_init(ring, RINGSIZE) < 0) {
+		err(1, "ioring_setup");
+	}
+	printf("%d chunks of %d bytes, ring of %d\n",
+	       NCHUNKS, CHUNKSIZE, RINGSIZE);
+
+	/* plain write loop */
+	fd = openfile(O_WRONLY|O_CREAT|O_TRUNC);
+	now(&start);
+	for (i = 0; i < NCHUNKS; i++) {
+		r = write(fd, chunks[i], CHUNKSIZE);
+		if (r != CHUNKSIZE) {
+			err(1, "write: chunk %d", i);
+		}
+	}
+	now(&end);
+	close(fd);
+	report("write loop", &start, &end);
+
+	/* plain read loop */
+	fd = openfile(O_RDONLY);
+	now(&start);
+	for (i = 0; i < NCHUNKS; i++) {
+		r = read(fd, readback[i], CHUNKSIZE);
+		if (r != CHUNKSIZE) {
+			err(1, "read: chunk %d", i);
+		}
+	}
+	now(&end);
+	close(fd);
+	report("read loop", &start, &end);
+	check("read loop");
+
+	/* batched writes */
+	fd = openfile(O_WRONLY|O_CREAT|O_TRUNC);
+	now(&start);
+	ringpass(ring, fd, 1, "ring write");
+	now(&end);
+	close(fd);
+	report("ring write", &start, &end);
+
+	/* batched reads */
+	fd = openfile(O_RDONLY);
+	now(&start);
+	ringpass(ring, fd, 0, "ring read");
+	now(&end);
+	close(fd);
+	report("ring read", &start, &end);
+	check("ring read");
+
+	if (remove(FILENAME) < 0 && errno != ENOSYS) {
+		warn("remove %s", FILENAME);
+	}
+	printf("ioringbench done.\n");
+	return 0;
+}
@@ -46,6 +46,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/resource.h>
 #include <assert.h>
 #include <err.h>
 
@@ -648,10 +649,19 @@ static
 int
 dotest(int tn)
 {
+	struct rusage ru0, ru1;
 	int i;
 	for (i=0; tests[i].num>=0; i++) {
 		if (tests[i].num == tn) {
+			getrusage(RUSAGE_SELF, &ru0);
 			tests[i].func();
+			getrusage(RUSAGE_SELF, &ru1);
+			printf("Page faults: %lu minor, %lu major; "
+			       "%lu pages mapped ahead\n",
+			       (unsigned long)(ru1.ru_minflt - ru0.ru_minflt),
+			       (unsigned long)(ru1.ru_majflt - ru0.ru_majflt),
+			       (unsigned long)(ru1.ru_prefault -
+					       ru0.ru_prefault));
 			return 0;
 		}
 	}
@@ -0,0 +1,113 @@
+/*
+ * mmapbig - map a file bigger than memory.
+ *
+ * Makes a file of BIGMB megabytes (an optional argument overrides
+ * that; it should be more than the machine's RAM), maps it shared and
+ * writes a word into every page, which only works if the kernel
+ * writes pages back to the file and drops them from the page cache
+ * as it goes. Then reads every page back through the mapping, checks
+ * the file itself after munmap, and maps it again to scan it once
+ * more, so that clean cached pages, mapped or not, get evicted too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <err.h>
+
+#define FILENAME	"mmapbig.dat"
+#define PAGE		4096
+#define BIGMB		8
+#define CHUNK		(64 * 1024)
+
+static char buf[CHUNK];
+
+/* the word written into page I */
+#define MARK(i)		((unsigned)(i) * 2654435761U)
+
+static
+void
+makefile(int fd, size_t size)
+{
+	size_t pos;
+
+	for (pos = 0; pos < size; pos += CHUNK) {
+		if (write(fd, buf, CHUNK) != CHUNK) {
+			err(1, "%s: write", FILENAME);
+		}
+	}
+}
+
+static
+void
+scan(const char *map, unsigned npages, const char *what)
+{
+	unsigned i;
+
+	for (i = 0; i < npages; i++) {
+		if (*(const unsigned *)(map + i * PAGE) != MARK(i)) {
+			errx(1, "%s: page %u lost its write", what, i);
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned mb, npages, i, word;
+	size_t size;
+	char *map;
+	int fd;
+
+	mb = BIGMB;
+	if (argc > 1) {
+		mb = atoi(argv[1]);
+	}
+	size = (size_t)mb * 1024 * 1024;
+	npages = size / PAGE;
+
+	fd = open(FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", FILENAME);
+	}
+	makefile(fd, size);
+
+	map = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		err(1, "mmap");
+	}
+	for (i = 0; i < npages; i++) {
+		*(unsigned *)(map + i * PAGE) = MARK(i);
+	}
+	printf("mmapbig: wrote %u pages through the mapping\n", npages);
+	scan(map, npages, "mapping");
+	if (munmap(map, size) < 0) {
+		err(1, "munmap");
+	}
+
+	for (i = 0; i < npages; i++) {
+		if (pread(fd, &word, sizeof(word), (off_t)i * PAGE) !=
+		    (ssize_t)sizeof(word)) {
+			err(1, "pread");
+		}
+		if (word != MARK(i)) {
+			errx(1, "file: page %u lost its write", i);
+		}
+	}
+	printf("mmapbig: the file has every write\n");
+
+	map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		err(1, "mmap again");
+	}
+	scan(map, npages, "second mapping");
+	if (munmap(map, size) < 0) {
+		err(1, "munmap again");
+	}
+
+	close(fd);
+	remove(FILENAME);
+	printf("mmapbig: passed\n");
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * mmaptest - check mmap, msync and munmap on a file.
+ *
+ * Makes a file a little over NPAGES pages long, maps it shared and
+ * private, and checks that the mappings read the file, that writes
+ * through the shared one reach the file on msync and munmap but
+ * never make it longer, that writes through the private one do not
+ * reach it at all, and that part of a mapping can be unmapped.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <err.h>
+#include <errno.h>
+
+#define FILENAME	"mmaptest.dat"
+#define PAGE		4096
+#define NPAGES		3
+#define TAIL		100	/* bytes in the last, partial page */
+#define FILESIZE	(NPAGES * PAGE + TAIL)
+#define MAPSIZE		((NPAGES + 1) * PAGE)
+
+static char buf[PAGE];
+
+/* what the file holds at POS to start with */
+static
+char
+pattern(off_t pos)
+{
+	return 'a' + (pos / 7) % 26;
+}
+
+static
+void
+check(const char *p, off_t pos, size_t len, const char *what)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (p[i] != pattern(pos + i)) {
+			errx(1, "%s: byte %lu is %d, not %d", what,
+			     (unsigned long)(pos + i), p[i],
+			     pattern(pos + i));
+		}
+	}
+}
+
+/* read the file's byte at POS */
+static
+char
+fileat(int fd, off_t pos)
+{
+	char ch;
+
+	if (pread(fd, &ch, 1, pos) != 1) {
+		err(1, "pread");
+	}
+	return ch;
+}
+
+int
+main(void)
+{
+	char *shared, *private;
+	off_t pos;
+	size_t i;
+	int fd;
+
+	fd = open(FILENAME, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", FILENAME);
+	}
+	for (pos = 0; pos < FILESIZE; pos += PAGE) {
+		for (i = 0; i < PAGE; i++) {
+			buf[i] = pattern(pos + i);
+		}
+		i = FILESIZE - pos < PAGE ? FILESIZE - pos : PAGE;
+		if (write(fd, buf, i) != (ssize_t)i) {
+			err(1, "%s: write", FILENAME);
+		}
+	}
+
+	/* bad arguments */
+	if (mmap(NULL, PAGE, PROT_READ, MAP_SHARED, fd, 1) != MAP_FAILED ||
+	    errno != EINVAL) {
+		errx(1, "unaligned offset was accepted");
+	}
+	if (mmap(NULL, PAGE, PROT_READ, 0, fd, 0) != MAP_FAILED ||
+	    errno != EINVAL) {
+		errx(1, "mapping with no type was accepted");
+	}
+	if (mmap(NULL, PAGE, PROT_READ, MAP_SHARED, 0, 0) != MAP_FAILED) {
+		errx(1, "console was mapped");
+	}
+
+	shared = mmap(NULL, MAPSIZE, PROT_READ|PROT_WRITE, MAP_SHARED,
+		      fd, 0);
+	if (shared == MAP_FAILED) {
+		err(1, "mmap shared");
+	}
+	check(shared, 0, FILESIZE, "shared mapping");
+	for (i = FILESIZE; i < MAPSIZE; i++) {
+		if (shared[i] != 0) {
+			errx(1, "byte %lu past the end is not zero",
+			     (unsigned long)i);
+		}
+	}
+	printf("mmaptest: shared mapping reads the file\n");
+
+	/* a private mapping of the same pages starts out the same */
+	private = mmap(NULL, 2 * PAGE, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+		       fd, PAGE);
+	if (private == MAP_FAILED) {
+		err(1, "mmap private");
+	}
+	check(private, PAGE, 2 * PAGE, "private mapping");
+
+	/* shared writes are seen by the other mapping, but private ones not */
+	shared[PAGE] = 'X';
+	if (private[0] != 'X') {
+		errx(1, "private mapping did not see a shared write");
+	}
+	private[1] = 'Y';
+	if (shared[PAGE + 1] == 'Y') {
+		errx(1, "shared mapping saw a private write");
+	}
+	printf("mmaptest: private writes stay private\n");
+
+	/* msync writes the shared page, and only within the file */
+	shared[FILESIZE] = 'Z';
+	if (msync(shared, MAPSIZE, MS_SYNC) < 0) {
+		err(1, "msync");
+	}
+	if (fileat(fd, PAGE) != 'X' ||
+	    fileat(fd, PAGE + 1) != pattern(PAGE + 1)) {
+		errx(1, "msync did not write back the shared write");
+	}
+	if (lseek(fd, 0, SEEK_END) != FILESIZE) {
+		errx(1, "msync made the file longer");
+	}
+	printf("mmaptest: msync writes back\n");
+
+	/* unmap the middle page, then the rest, which writes it back */
+	if (munmap(shared + PAGE, PAGE) < 0) {
+		err(1, "munmap middle");
+	}
+	shared[2 * PAGE] = 'W';
+	check(shared, 0, PAGE, "first page after munmap");
+	if (munmap(shared, MAPSIZE) < 0) {
+		err(1, "munmap");
+	}
+	if (fileat(fd, 2 * PAGE) != 'W') {
+		errx(1, "munmap did not write back the shared write");
+	}
+	if (munmap(private, 2 * PAGE) < 0) {
+		err(1, "munmap private");
+	}
+	if (fileat(fd, PAGE + 1) != pattern(PAGE + 1)) {
+		errx(1, "private write reached the file");
+	}
+	printf("mmaptest: munmap writes back\n");
+
+	close(fd);
+	remove(FILENAME);
+	printf("mmaptest: passed\n");
+	return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * pipebench - measure pipe throughput.
+ *
+ * Forks; the child writes TOTALMB megabytes into a pipe in CHUNKSIZE
+ * writes and the parent reads them back, checking the data pattern
+ * and counting bytes until end of file. Prints the elapsed time and
+ * the throughput in MB/s. An optional argument overrides the size in
+ * megabytes.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define TOTALMB		100
+#define CHUNKSIZE	(64 * 1024)
+#define MB		(1024 * 1024)
+
+static char buf[CHUNKSIZE];
+
+/* byte at stream offset pos */
+static
+char
+pattern(unsigned long long pos)
+{
+	return (char)(pos * 7 + pos / 4096);
+}
+
+static
+void
+fill(unsigned long long pos, size_t len)
+{
+	size_t i;
+
+	for (i=0; i<len; i++) {
+		buf[i] = pattern(pos + i);
+	}
+}
+
+static
+void
+writer(int fd, unsigned long long total)
+{
+	unsigned long long pos;
+	size_t len;
+	ssize_t r;
+
+	for (pos = 0; pos < total; pos += r) {
+		len = CHUNKSIZE;
+		if (len > total - pos) {
+			len = total - pos;
+		}
+		fill(pos, len);
+		r = write(fd, buf, len);
+		if (r <= 0) {
+			err(1, "write");
+		}
+	}
+}
+
+static
+unsigned long long
+reader(int fd)
+{
+	unsigned long long pos;
+	ssize_t r, i;
+
+	pos = 0;
+	while ((r = read(fd, buf, sizeof(buf))) > 0) {
+		for (i=0; i<r; i++) {
+			if (buf[i] != pattern(pos + i)) {
+				errx(1, "Data mismatch at byte %llu", pos + i);
+			}
+		}
+		pos += r;
+	}
+	if (r < 0) {
+		err(1, "read");
+	}
+	return pos;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long long total, got, ns;
+	time_t s0, s1;
+	unsigned long ns0, ns1;
+	int fds[2];
+	int status;
+	pid_t pid;
+
+	total = TOTALMB;
+	if (argc > 1) {
+		total = atoi(argv[1]);
+	}
+	total *= MB;
+
+	if (pipe(fds) < 0) {
+		err(1, "pipe");
+	}
+
+	__time(&s0, &ns0);
+
+	pid = fork();
+	if (pid < 0) {
+		err(1, "fork");
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		writer(fds[1], total);
+		close(fds[1]);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	got = reader(fds[0]);
+	close(fds[0]);
+
+	__time(&s1, &ns1);
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "Writer failed");
+	}
+	if (got != total) {
+		errx(1, "Read %llu bytes, expected %llu", got, total);
+	}
+
+	ns = (s1 - s0) * 1000000000ULL + ns1 - ns0;
+	if (ns == 0) {
+		ns = 1;
+	}
+	printf("%llu MB in %lu.%09lu s: %lu MB/s\n", total / MB,
+	       (unsigned long)(ns / 1000000000ULL),
+	       (unsigned long)(ns % 1000000000ULL),
+	       (unsigned long)(total * 1000000000ULL / MB / ns));
+	printf("pipebench: passed\n");
+	return 0;
+}
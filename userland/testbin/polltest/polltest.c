@@ -0,0 +1,138 @@
+/*
+ * polltest - check poll() and select() against a semfs semaphore
+ * and the console.
+ *
+ * A semaphore is readable (P won't block) exactly when its count is
+ * nonzero, so its readiness can be switched on and off from one
+ * process with write() and read(). Also checks timeouts and bad
+ * descriptors.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <err.h>
+#include <errno.h>
+
+#define SEMNAME		"sem:polltest"
+#define TIMEOUT_MS	200
+
+static
+unsigned long
+elapsed_ms(time_t s0, unsigned long ns0)
+{
+	time_t s1;
+	unsigned long ns1;
+
+	__time(&s1, &ns1);
+	return (s1 - s0) * 1000 + ns1 / 1000000 - ns0 / 1000000;
+}
+
+static
+int
+pollone(int fd, int events, int timeout, short *revents)
+{
+	struct pollfd pfd;
+	int r;
+
+	pfd.fd = fd;
+	pfd.events = events;
+	pfd.revents = 0;
+	r = poll(&pfd, 1, timeout);
+	if (r < 0) {
+		err(1, "poll");
+	}
+	*revents = pfd.revents;
+	return r;
+}
+
+int
+main(void)
+{
+	fd_set rfds, wfds;
+	struct timeval tv;
+	time_t s0;
+	unsigned long ns0, ms;
+	short revents;
+	char ch = 0;
+	int fd, r;
+
+	fd = open(SEMNAME, O_RDWR|O_CREAT|O_TRUNC);
+	if (fd < 0) {
+		err(1, "%s", SEMNAME);
+	}
+
+	/* count 0: not readable, but writable */
+	r = pollone(fd, POLLIN|POLLOUT, 0, &revents);
+	if (r != 1 || revents != POLLOUT) {
+		errx(1, "empty semaphore: poll gave %d, revents 0x%x",
+		     r, revents);
+	}
+	printf("polltest: empty semaphore is write-only ready\n");
+
+	/* and waiting for it times out */
+	__time(&s0, &ns0);
+	r = pollone(fd, POLLIN, TIMEOUT_MS, &revents);
+	ms = elapsed_ms(s0, ns0);
+	if (r != 0) {
+		errx(1, "timeout: poll gave %d, revents 0x%x", r, revents);
+	}
+	if (ms < TIMEOUT_MS) {
+		errx(1, "timeout: poll returned after %lu ms", ms);
+	}
+	printf("polltest: %d ms timeout took %lu ms\n", TIMEOUT_MS, ms);
+
+	/* V() makes it readable */
+	if (write(fd, &ch, 1) != 1) {
+		err(1, "%s: write", SEMNAME);
+	}
+	r = pollone(fd, POLLIN, -1, &revents);
+	if (r != 1 || revents != POLLIN) {
+		errx(1, "after V: poll gave %d, revents 0x%x", r, revents);
+	}
+	printf("polltest: semaphore readable after V\n");
+
+	/* select agrees, and stdout is writable */
+	FD_ZERO(&rfds);
+	FD_ZERO(&wfds);
+	FD_SET(fd, &rfds);
+	FD_SET(STDOUT_FILENO, &wfds);
+	tv.tv_sec = 0;
+	tv.tv_usec = 0;
+	r = select(fd + 1, &rfds, &wfds, NULL, &tv);
+	if (r != 2 || !FD_ISSET(fd, &rfds) || !FD_ISSET(STDOUT_FILENO, &wfds)) {
+		errx(1, "select gave %d", r);
+	}
+	printf("polltest: select sees both\n");
+
+	/* P() takes it away again */
+	if (read(fd, &ch, 1) != 1) {
+		err(1, "%s: read", SEMNAME);
+	}
+	r = pollone(fd, POLLIN, 0, &revents);
+	if (r != 0) {
+		errx(1, "after P: poll gave %d, revents 0x%x", r, revents);
+	}
+	printf("polltest: semaphore not readable after P\n");
+
+	close(fd);
+	remove(SEMNAME);
+
+	/* closed descriptors */
+	r = pollone(fd, POLLIN, 0, &revents);
+	if (r != 1 || revents != POLLNVAL) {
+		errx(1, "closed fd: poll gave %d, revents 0x%x", r, revents);
+	}
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+	r = select(fd + 1, &rfds, NULL, NULL, &tv);
+	if (r != -1 || errno != EBADF) {
+		errx(1, "closed fd: select gave %d", r);
+	}
+	printf("polltest: closed descriptors rejected\n");
+
+	printf("polltest: passed\n");
+	return 0;
+}
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <err.h>
 #include <errno.h>
 
@@ -1062,6 +1063,84 @@ test21(void)
 	stresstest(geti(), true);
 }
 
+////////////////////////////////////////////////////////////
+// lazy allocation
+
+#define LAZYPAGES	4096	/* 16M of heap */
+#define LAZYSTRIDE	64	/* touch every this many pages */
+
+/* page faults taken so far */
+static
+unsigned long
+faults(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0) {
+		err(1, "getrusage");
+	}
+	return (unsigned long)(ru.ru_minflt + ru.ru_majflt);
+}
+
+/*
+ * Raise the break a long way, which should not touch memory and so
+ * take no page faults; then touch some of the pages, which should
+ * fault each one in once, zero-filled. Lower the break and raise it
+ * again, and the pages should come back zeroed.
+ */
+static
+void
+test22(void)
+{
+	unsigned long f0, f1, f2, f3;
+	unsigned i, n;
+	char *p;
+
+	n = LAZYPAGES / LAZYSTRIDE;
+	(void)faults();
+
+	f0 = faults();
+	p = dosbrk(LAZYPAGES * PAGE_SIZE);
+	f1 = faults();
+	for (i=0; i<LAZYPAGES; i+=LAZYSTRIDE) {
+		if (p[i * PAGE_SIZE] != 0) {
+			errx(1, "FAILED: new heap page %u not zeroed", i);
+		}
+		markpagelight(p, i);
+	}
+	f2 = faults();
+	for (i=0; i<LAZYPAGES; i+=LAZYSTRIDE) {
+		if (checkpagelight(p, i, false)) {
+			errx(1, "FAILED: data corrupt");
+		}
+	}
+	f3 = faults();
+
+	printf("sbrk of %u pages took %lu faults\n", LAZYPAGES, f1 - f0);
+	printf("touching %u of them took %lu, and again %lu\n", n,
+	       f2 - f1, f3 - f2);
+	/* allow for a page or two the pager happened to take away */
+	if (f1 - f0 > 2) {
+		errx(1, "FAILED: sbrk touched the pages");
+	}
+	if (f2 - f1 < n) {
+		errx(1, "FAILED: fewer faults than pages touched");
+	}
+
+	/* gone, and zero when they come back */
+	dosbrk(-(LAZYPAGES * PAGE_SIZE));
+	p = dosbrk(LAZYPAGES * PAGE_SIZE);
+	for (i=0; i<LAZYPAGES; i+=LAZYSTRIDE) {
+		if (p[i * PAGE_SIZE] != 0) {
+			errx(1, "FAILED: heap page %u not zeroed after "
+			     "shrinking", i);
+		}
+	}
+	dosbrk(-(LAZYPAGES * PAGE_SIZE));
+
+	printf("Passed sbrk test 22.\n");
+}
+
 ////////////////////////////////////////////////////////////
 // main
 
@@ -1091,6 +1170,7 @@ static const struct {
 	{ 19, "Large stress test", test19 },
 	{ 20, "Randomized large stress test", test20 },
 	{ 21, "Large stress test with particular seed", test21 },
+	{ 22, "Grow the heap lazily and count page faults", test22 },
 };
 static const unsigned numtests = sizeof(tests) / sizeof(tests[0]);
 
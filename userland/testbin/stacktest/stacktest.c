@@ -0,0 +1,76 @@
+/*
+ * stacktest - grow the stack on demand.
+ *
+ * Recurses through about a megabyte of stack, which starts out as a
+ * single page, and checks every frame on the way back up. Also checks
+ * that RLIMIT_STACK leaves room for that and that its hard limit
+ * can't be exceeded. (Running past the limit is a fatal fault, which
+ * still panics the kernel, so that isn't tried.)
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include <err.h>
+
+#define FRAME		1000
+#define DEPTH		1000	/* about 1M of stack */
+
+static
+unsigned
+recurse(unsigned depth)
+{
+	volatile unsigned char buf[FRAME];
+	unsigned i, sum;
+
+	for (i = 0; i < FRAME; i++) {
+		buf[i] = (unsigned char)(depth + i);
+	}
+	sum = depth > 0 ? recurse(depth - 1) : 0;
+	for (i = 0; i < FRAME; i++) {
+		if (buf[i] != (unsigned char)(depth + i)) {
+			errx(1, "depth %u: frame corrupted at %u", depth, i);
+		}
+	}
+	return sum + 1;
+}
+
+static
+void
+limits(void)
+{
+	struct rlimit rl, bad;
+
+	if (getrlimit(RLIMIT_STACK, &rl) < 0) {
+		err(1, "getrlimit");
+	}
+	printf("stacktest: stack limit %lu, hard limit %lu\n",
+	       (unsigned long)rl.rlim_cur, (unsigned long)rl.rlim_max);
+	if (rl.rlim_cur < DEPTH * FRAME) {
+		errx(1, "default stack limit too small for the test");
+	}
+
+	bad = rl;
+	bad.rlim_cur = rl.rlim_max + 4096;
+	if (setrlimit(RLIMIT_STACK, &bad) == 0 || errno != EINVAL) {
+		errx(1, "setrlimit above the hard limit did not fail");
+	}
+	bad.rlim_max = rl.rlim_max * 2;
+	if (setrlimit(RLIMIT_STACK, &bad) == 0 || errno != EPERM) {
+		errx(1, "raising the hard limit did not fail");
+	}
+}
+
+int
+main(void)
+{
+	limits();
+	if (recurse(DEPTH) != DEPTH + 1) {
+		errx(1, "wrong recursion count");
+	}
+	printf("stacktest: recursed through %u bytes of stack\n",
+	       DEPTH * FRAME);
+	printf("stacktest: passed\n");
+	return 0;
+}